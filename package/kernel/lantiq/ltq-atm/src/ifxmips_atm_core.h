@@ -44,6 +44,8 @@ struct ltq_atm_ops {
 };
 
 #include <linux/atomic.h>
+#include <linux/netdevice.h>
+#include <linux/hashtable.h>
 #include <lantiq_atm.h>
 
 /*
@@ -121,6 +123,7 @@ struct ltq_atm_ops {
 #define QSB_RESERVE_TX_QUEUE            0
 #define FIRST_QSB_QID                   1
 #define MAX_PVC_NUMBER                  (MAX_QUEUE_NUMBER - FIRST_QSB_QID)
+#define PVC_HASH_BITS                   5
 #define MAX_RX_DMA_CHANNEL_NUMBER       8
 #define MAX_TX_DMA_CHANNEL_NUMBER       16
 #define DATA_BUFFER_ALIGNMENT           EMA_ALIGNMENT
@@ -192,6 +195,9 @@ struct port {
 
 struct connection {
 	struct atm_vcc         *vcc;
+	struct hlist_node       hnode;  /*  entry in VPI/VCI lookup table   */
+	unsigned int            vpi;
+	unsigned int            vci;
 
 	volatile struct tx_descriptor *tx_desc;
 	unsigned int tx_desc_pos;
@@ -201,12 +207,18 @@ struct connection {
 	unsigned int aal5_vcc_crc_err; /* number of packets with CRC error */
 	unsigned int aal5_vcc_oversize_sdu; /* number of packets with oversize error */
 
+	unsigned int rx_pdu; /* number of packets pushed to upper layer */
+	u64 rx_bytes; /* number of bytes pushed to upper layer */
+	unsigned int rx_drop; /* number of packets dropped by driver on RX */
+
 	unsigned int port;
 };
 
 struct atm_priv_data {
 	unsigned long conn_table;
 	struct connection conn[MAX_PVC_NUMBER];
+	DECLARE_HASHTABLE(conn_hash, PVC_HASH_BITS);    /*  VPI/VCI to connection   */
+	spinlock_t conn_hash_lock;
 
 	volatile struct rx_descriptor *aal_desc;
 	unsigned int aal_desc_pos;
@@ -234,6 +246,9 @@ struct atm_priv_data {
 	unsigned int prev_wrx_total_byte;
 	unsigned int prev_wtx_total_byte;
 
+	struct net_device napi_dev;  /*  dummy device, ATM has no netdev for NAPI    */
+	struct napi_struct napi;
+
 	void *aal_desc_base;
 	void *oam_desc_base;
 	void *oam_buf_base;
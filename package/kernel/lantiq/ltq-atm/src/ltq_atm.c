@@ -53,6 +53,8 @@
 #define MODULE_PARM_ARRAY(a, b)   module_param_array(a, int, NULL, 0)
 #define MODULE_PARM(a, b)         module_param(a, int, 0)
 
+#define VPIVCI_KEY(vpi, vci)      (((vpi) << 16) | (vci))
+
 /*!
   \brief QSB cell delay variation due to concurrency
  */
@@ -108,6 +110,10 @@ static int dma_tx_descriptor_length = 64;       /*  Number of descriptors per DM
   \brief PPE core clock cycles between descriptor write and effectiveness in external RAM
  */
 static int dma_rx_clp1_descriptor_threshold = 38;
+/*!
+  \brief Maximum number of AAL5 frames received per NAPI poll
+ */
+static int napi_weight = NAPI_POLL_WEIGHT;      /*  Maximum number of frames per NAPI poll          */
 /*@}*/
 
 MODULE_PARM(qsb_tau, "i");
@@ -139,6 +145,8 @@ MODULE_PARM(dma_tx_descriptor_length, "i");
 MODULE_PARM_DESC(dma_tx_descriptor_length, "Number of descriptor assigned to DMA TX channel (>16)");
 MODULE_PARM(dma_rx_clp1_descriptor_threshold, "i");
 MODULE_PARM_DESC(dma_rx_clp1_descriptor_threshold, "Descriptor threshold for cells with cell loss priority 1");
+MODULE_PARM(napi_weight, "i");
+MODULE_PARM_DESC(napi_weight, "Maximum number of AAL5 frames received per NAPI poll (1-64)");
 
 
 
@@ -172,6 +180,7 @@ static void ppe_close(struct atm_vcc *);
 static int ppe_send(struct atm_vcc *, struct sk_buff *);
 static int ppe_send_oam(struct atm_vcc *, void *, int);
 static int ppe_change_qos(struct atm_vcc *, struct atm_qos *, int);
+static int ppe_proc_read(struct atm_dev *, loff_t *, char *);
 
 /*
  *  ADSL LED
@@ -196,15 +205,10 @@ static inline int get_tx_desc(unsigned int);
  *  mailbox handler and signal function
  */
 static inline void mailbox_oam_rx_handler(void);
-static inline void mailbox_aal_rx_handler(void);
+static inline int mailbox_aal_rx_handler(int);
 static irqreturn_t mailbox_irq_handler(int, void *);
 static inline void mailbox_signal(unsigned int, int);
-static void do_ppe_tasklet(unsigned long);
-#if LINUX_VERSION_CODE < KERNEL_VERSION(5,9,0)
-DECLARE_TASKLET(g_dma_tasklet, do_ppe_tasklet, 0);
-#else
-DECLARE_TASKLET_OLD(g_dma_tasklet, do_ppe_tasklet);
-#endif
+static int ppe_napi_poll(struct napi_struct *, int);
 
 /*
  *  QSB & HTU setting functions
@@ -274,6 +278,7 @@ static struct atmdev_ops g_ifx_atm_ops = {
 	.send = ppe_send,
 	.send_oam = ppe_send_oam,
 	.change_qos = ppe_change_qos,
+	.proc_read = ppe_proc_read,
 	.owner = THIS_MODULE,
 };
 
@@ -397,6 +402,7 @@ static int ppe_open(struct atm_vcc *vcc)
 	for ( conn = 0; conn < MAX_PVC_NUMBER; conn++ ) {
 		if ( test_and_set_bit(conn, &g_atm_priv_data.conn_table) == 0 ) {
 			g_atm_priv_data.conn[conn].vcc = vcc;
+			g_atm_priv_data.conn[conn].port = (int)vcc->dev->dev_data;
 			break;
 		}
 	}
@@ -430,6 +436,14 @@ static int ppe_open(struct atm_vcc *vcc)
 	vcc->vci = vci;
 	set_bit(ATM_VF_READY, &vcc->flags);
 
+	/*  add to lookup tables    */
+	g_atm_priv_data.conn[conn].vpi = vpi;
+	g_atm_priv_data.conn[conn].vci = vci;
+	vcc->dev_data = (void *)(conn + 1);
+	spin_lock_bh(&g_atm_priv_data.conn_hash_lock);
+	hash_add_rcu(g_atm_priv_data.conn_hash, &g_atm_priv_data.conn[conn].hnode, VPIVCI_KEY(vpi, vci));
+	spin_unlock_bh(&g_atm_priv_data.conn_hash_lock);
+
 	/*  enable irq  */
 	if ( f_enable_irq ) {
 		*MBOX_IGU1_ISRC = (1 << RX_DMA_CH_AAL) | (1 << RX_DMA_CH_OAM);
@@ -473,10 +487,19 @@ static void ppe_close(struct atm_vcc *vcc)
 	/*  clear htu   */
 	clear_htu_entry(conn);
 
+	/*  remove from lookup tables   */
+	spin_lock_bh(&g_atm_priv_data.conn_hash_lock);
+	hash_del_rcu(&connection->hnode);
+	spin_unlock_bh(&g_atm_priv_data.conn_hash_lock);
+	vcc->dev_data = NULL;
+
 	/*  release connection  */
 	connection->vcc = NULL;
 	connection->aal5_vcc_crc_err = 0;
 	connection->aal5_vcc_oversize_sdu = 0;
+	connection->rx_pdu = 0;
+	connection->rx_bytes = 0;
+	connection->rx_drop = 0;
 	clear_bit(conn, &g_atm_priv_data.conn_table);
 
 	/*  disable irq */
@@ -501,7 +524,7 @@ static void ppe_close(struct atm_vcc *vcc)
 	}
 
 	/* wait for incoming packets to be processed by upper layers */
-	tasklet_unlock_wait(&g_dma_tasklet);
+	synchronize_net();
 
 PPE_CLOSE_EXIT:
 	return;
@@ -724,6 +747,33 @@ static int ppe_change_qos(struct atm_vcc *vcc, struct atm_qos *qos, int flags)
 	return 0;
 }
 
+static int ppe_proc_read(struct atm_dev *dev, loff_t *pos, char *page)
+{
+	int port_num = (int)dev->dev_data;
+	struct connection *connection;
+	loff_t left = *pos;
+	int conn;
+
+	if ( left-- == 0 )
+		return sprintf(page, "%-12s %10s %20s %10s %10s %10s\n",
+			"vpi/vci", "rx_pdu", "rx_bytes", "rx_drop", "crc_err", "oversize");
+
+	for ( conn = 0; conn < MAX_PVC_NUMBER; conn++ ) {
+		connection = &g_atm_priv_data.conn[conn];
+		if ( !test_bit(conn, &g_atm_priv_data.conn_table) || connection->vcc == NULL || connection->port != port_num )
+			continue;
+		if ( left-- != 0 )
+			continue;
+
+		return sprintf(page, "%5u/%-6u %10u %20llu %10u %10u %10u\n",
+			connection->vpi, connection->vci, connection->rx_pdu,
+			(unsigned long long)connection->rx_bytes, connection->rx_drop,
+			connection->aal5_vcc_crc_err, connection->aal5_vcc_oversize_sdu);
+	}
+
+	return 0;
+}
+
 static inline void adsl_led_flash(void)
 {
 	ifx_mei_atm_led_blink();
@@ -911,7 +961,7 @@ static inline void mailbox_oam_rx_handler(void)
 	}
 }
 
-static inline void mailbox_aal_rx_handler(void)
+static inline int mailbox_aal_rx_handler(int budget)
 {
 	unsigned int vlddes = WRX_DMA_CHANNEL_CONFIG(RX_DMA_CH_AAL)->vlddes;
 	struct rx_descriptor reg_desc;
@@ -921,6 +971,9 @@ static inline void mailbox_aal_rx_handler(void)
 	struct rx_inband_trailer *trailer;
 	unsigned int i;
 
+	if ( vlddes > budget )
+		vlddes = budget;
+
 	for ( i = 0; i < vlddes; i++ ) {
 		unsigned int loop_count = 0;
 
@@ -947,6 +1000,7 @@ static inline void mailbox_aal_rx_handler(void)
 						g_atm_priv_data.conn[conn].aal5_vcc_oversize_sdu++;
 					g_atm_priv_data.wrx_drop_pdu++;
 				}
+				g_atm_priv_data.conn[conn].rx_drop++;
 				if ( vcc->stats ) {
 					atomic_inc(&vcc->stats->rx_drop);
 					atomic_inc(&vcc->stats->rx_err);
@@ -966,6 +1020,9 @@ static inline void mailbox_aal_rx_handler(void)
 
 					vcc->push(vcc, skb);
 
+					g_atm_priv_data.conn[conn].rx_pdu++;
+					g_atm_priv_data.conn[conn].rx_bytes += reg_desc.datalen;
+
 					if ( vcc->qos.aal == ATM_AAL5 )
 						g_atm_priv_data.wrx_pdu++;
 					if ( vcc->stats )
@@ -977,12 +1034,14 @@ static inline void mailbox_aal_rx_handler(void)
 					atm_return(vcc, skb->truesize);
 					if ( vcc->qos.aal == ATM_AAL5 )
 						g_atm_priv_data.wrx_drop_pdu++;
+					g_atm_priv_data.conn[conn].rx_drop++;
 					if ( vcc->stats )
 						atomic_inc(&vcc->stats->rx_drop);
 				}
 			} else {
 				if ( vcc->qos.aal == ATM_AAL5 )
 					g_atm_priv_data.wrx_drop_pdu++;
+				g_atm_priv_data.conn[conn].rx_drop++;
 				if ( vcc->stats )
 					atomic_inc(&vcc->stats->rx_drop);
 			}
@@ -1001,15 +1060,19 @@ static inline void mailbox_aal_rx_handler(void)
 
 		mailbox_signal(RX_DMA_CH_AAL, 0);
 	}
+
+	return vlddes;
 }
 
-static void do_ppe_tasklet(unsigned long data)
+static int ppe_napi_poll(struct napi_struct *napi, int budget)
 {
 	unsigned int irqs = *MBOX_IGU1_ISR;
-	*MBOX_IGU1_ISRC = *MBOX_IGU1_ISR;
+	int work_done;
 
-	if (irqs & (1 << RX_DMA_CH_AAL))
-		mailbox_aal_rx_handler();
+	*MBOX_IGU1_ISRC = irqs;
+
+	/* the AAL ring may still hold frames left over from the previous poll */
+	work_done = mailbox_aal_rx_handler(budget);
 	if (irqs & (1 << RX_DMA_CH_OAM))
 		mailbox_oam_rx_handler();
 
@@ -1017,12 +1080,18 @@ static void do_ppe_tasklet(unsigned long data)
 	if ((irqs >> (FIRST_QSB_QID + 16)) & g_atm_priv_data.conn_table)
 		mailbox_tx_handler(irqs >> (FIRST_QSB_QID + 16));
 
+	/* keep polling until the AAL ring is empty and no new event is pending */
+	if (work_done >= budget || WRX_DMA_CHANNEL_CONFIG(RX_DMA_CH_AAL)->vlddes != 0)
+		return budget;
 	if ((*MBOX_IGU1_ISR & ((1 << RX_DMA_CH_AAL) | (1 << RX_DMA_CH_OAM))) != 0)
-		tasklet_schedule(&g_dma_tasklet);
-	else if (*MBOX_IGU1_ISR >> (FIRST_QSB_QID + 16)) /* TX queue */
-		tasklet_schedule(&g_dma_tasklet);
-	else
+		return budget;
+	if (*MBOX_IGU1_ISR >> (FIRST_QSB_QID + 16)) /* TX queue */
+		return budget;
+
+	if (napi_complete_done(napi, work_done))
 		enable_irq(PPE_MAILBOX_IGU1_INT);
+
+	return work_done;
 }
 
 static irqreturn_t mailbox_irq_handler(int irq, void *dev_id)
@@ -1031,7 +1100,7 @@ static irqreturn_t mailbox_irq_handler(int irq, void *dev_id)
 		return IRQ_HANDLED;
 
 	disable_irq_nosync(PPE_MAILBOX_IGU1_INT);
-	tasklet_schedule(&g_dma_tasklet);
+	napi_schedule(&g_atm_priv_data.napi);
 
 	return IRQ_HANDLED;
 }
@@ -1290,32 +1359,31 @@ static inline int find_vpi(unsigned int vpi)
 
 static inline int find_vpivci(unsigned int vpi, unsigned int vci)
 {
-	int i;
-	unsigned int bit;
+	struct connection *connection;
+	int conn = -1;
 
-	for ( i = 0, bit = 1; i < MAX_PVC_NUMBER; i++, bit <<= 1 ) {
-		if ( (g_atm_priv_data.conn_table & bit) != 0
-				&& g_atm_priv_data.conn[i].vcc != NULL
-				&& vpi == g_atm_priv_data.conn[i].vcc->vpi
-				&& vci == g_atm_priv_data.conn[i].vcc->vci )
-			return i;
+	rcu_read_lock();
+	hash_for_each_possible_rcu(g_atm_priv_data.conn_hash, connection, hnode, VPIVCI_KEY(vpi, vci)) {
+		if ( connection->vpi == vpi && connection->vci == vci ) {
+			conn = connection - g_atm_priv_data.conn;
+			break;
+		}
 	}
+	rcu_read_unlock();
 
-	return -1;
+	return conn;
 }
 
 static inline int find_vcc(struct atm_vcc *vcc)
 {
-	int i;
-	unsigned int bit;
+	/*  connection id + 1 is kept in vcc->dev_data while the vcc is open  */
+	int conn = (int)vcc->dev_data - 1;
 
-	for ( i = 0, bit = 1; i < MAX_PVC_NUMBER; i++, bit <<= 1 ) {
-		if ( (g_atm_priv_data.conn_table & bit) != 0
-			&& g_atm_priv_data.conn[i].vcc == vcc )
-		return i;
-	}
+	if ( conn < 0 || conn >= MAX_PVC_NUMBER
+			|| g_atm_priv_data.conn[conn].vcc != vcc )
+		return -1;
 
-	return -1;
+	return conn;
 }
 
 static inline int ifx_atm_version(const struct ltq_atm_ops *ops, char *buf)
@@ -1385,6 +1453,11 @@ static inline void check_parameters(void)
 
 	if ( dma_tx_descriptor_length < 2 )
 		dma_tx_descriptor_length = 2;
+
+	if ( napi_weight < 1 )
+		napi_weight = 1;
+	else if ( napi_weight > NAPI_POLL_WEIGHT )
+		napi_weight = NAPI_POLL_WEIGHT;
 }
 
 static inline int init_priv_data(void)
@@ -1398,6 +1471,8 @@ static inline int init_priv_data(void)
 
 	//  clear atm private data structure
 	memset(&g_atm_priv_data, 0, sizeof(g_atm_priv_data));
+	hash_init(g_atm_priv_data.conn_hash);
+	spin_lock_init(&g_atm_priv_data.conn_hash_lock);
 
 	//  allocate memory for RX (AAL) descriptors
 	p = kzalloc(dma_rx_descriptor_length * sizeof(struct rx_descriptor) + DESC_ALIGNMENT, GFP_KERNEL);
@@ -1782,6 +1857,10 @@ static int ltq_atm_probe(struct platform_device *pdev)
 		goto INIT_PRIV_DATA_FAIL;
 	}
 
+	init_dummy_netdev(&g_atm_priv_data.napi_dev);
+	netif_napi_add(&g_atm_priv_data.napi_dev, &g_atm_priv_data.napi, ppe_napi_poll, napi_weight);
+	napi_enable(&g_atm_priv_data.napi);
+
 	ops->init(pdev);
 	init_rx_tables();
 	init_tx_tables();
@@ -1850,6 +1929,8 @@ REQUEST_IRQ_PPE_MAILBOX_IGU1_INT_FAIL:
 ATM_DEV_REGISTER_FAIL:
 	while ( port_num-- > 0 )
 		atm_dev_deregister(g_atm_priv_data.port[port_num].dev);
+	napi_disable(&g_atm_priv_data.napi);
+	netif_napi_del(&g_atm_priv_data.napi);
 INIT_PRIV_DATA_FAIL:
 	clear_priv_data();
 	printk("ifxmips_atm: ATM init failed\n");
@@ -1870,6 +1951,9 @@ static int ltq_atm_remove(struct platform_device *pdev)
 
 	free_irq(PPE_MAILBOX_IGU1_INT, &g_atm_priv_data);
 
+	napi_disable(&g_atm_priv_data.napi);
+	netif_napi_del(&g_atm_priv_data.napi);
+
 	for ( port_num = 0; port_num < ATM_PORT_NUMBER; port_num++ )
 		atm_dev_deregister(g_atm_priv_data.port[port_num].dev);
 
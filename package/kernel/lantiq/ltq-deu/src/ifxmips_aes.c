@@ -86,6 +86,14 @@ spinlock_t aes_lock;
 #define CRTCL_SECT_START       spin_lock_irqsave(&aes_lock, flag)
 #define CRTCL_SECT_END         spin_unlock_irqrestore(&aes_lock, flag)
 
+/* Maximum number of bytes processed per critical section */
+#define AES_CRTCL_CHUNK        512
+
+/* Key generation currently loaded into the hardware, protected by aes_lock */
+static atomic_t aes_key_gen = ATOMIC_INIT(0);
+static u32 aes_hw_key_gen;
+static int aes_hw_key_tweak;
+
 /* Definition of constants */
 #define AES_START   IFX_AES_CON
 #define AES_MIN_KEY_SIZE    16
@@ -128,6 +136,7 @@ struct aes_ctx {
     u8 nonce[CTR_RFC3686_NONCE_SIZE];
     u8 lastbuffer[4 * XTS_BLOCK_SIZE];
     int use_tweak;
+    u32 key_gen;
     u32 byte_count;
     u32 dbn;
     int started;
@@ -162,6 +171,7 @@ int aes_set_key (struct crypto_tfm *tfm, const u8 *in_key, unsigned int key_len)
 
     ctx->key_length = key_len;
     ctx->use_tweak = 0;
+    ctx->key_gen = atomic_inc_return(&aes_key_gen);
     DPRINTF(0, "ctx @%p, key_len %d, ctx->key_length %d\n", ctx, key_len, ctx->key_length);
     memcpy ((u8 *) (ctx->buf), in_key, key_len);
 
@@ -183,9 +193,10 @@ int aes_set_key_skcipher (struct crypto_skcipher *tfm, const u8 *in_key, unsigne
 }
 
 
-/*! \fn void aes_set_key_skcipher (void *ctx_arg)
+/*! \fn void aes_set_key_hw (void *ctx_arg)
  *  \ingroup IFX_AES_FUNCTIONS
- *  \brief sets the AES key to the hardware, requires spinlock to be set by caller
+ *  \brief sets the AES key to the hardware, requires spinlock to be set by caller.
+ *         The key is not reloaded if it is still the one in the hardware.
  *  \param ctx_arg crypto algo context  
  *  \return
 */
@@ -198,6 +209,10 @@ void aes_set_key_hw (void *ctx_arg)
     int key_len = ctx->key_length;
     /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+    if (ctx->key_gen && ctx->key_gen == aes_hw_key_gen &&
+        ctx->use_tweak == aes_hw_key_tweak)
+        return;
+
     if (ctx->use_tweak) in_key = ctx->tweakkey;
 
     /* 128, 192 or 256 bit key length */
@@ -228,6 +243,7 @@ void aes_set_key_hw (void *ctx_arg)
     }
     else {
         printk (KERN_ERR "[%s %s %d]: Invalid key_len : %d\n", __FILE__, __func__, __LINE__, key_len);
+        aes_hw_key_gen = 0;
         return; //-EINVAL;
     }
 
@@ -236,6 +252,9 @@ void aes_set_key_hw (void *ctx_arg)
        checked in decryption routine! */
     aes->controlr.PNK = 1;
 
+    aes_hw_key_gen = ctx->key_gen;
+    aes_hw_key_tweak = ctx->use_tweak;
+
 }
 
 
@@ -257,80 +276,87 @@ void ifx_deu_aes (void *ctx_arg, u8 *out_arg, const u8 *in_arg,
 {
     /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
     volatile struct aes_t *aes = (volatile struct aes_t *) AES_START;
-    struct aes_ctx *ctx = (struct aes_ctx *)ctx_arg;
     unsigned long flag;
     /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
     int i = 0;
     int byte_cnt = nbytes; 
+    int chunk_cnt;
+
+    /* The engine is only held for AES_CRTCL_CHUNK bytes at a time so that
+       large requests do not keep interrupts disabled for the whole buffer.
+       The IV is saved after every chunk and restored before the next. */
+    while (byte_cnt > 0) {
+        chunk_cnt = byte_cnt > AES_CRTCL_CHUNK ? AES_CRTCL_CHUNK : byte_cnt;
+        byte_cnt -= chunk_cnt;
+
+        CRTCL_SECT_START;
+
+        aes_set_key_hw (ctx_arg);
+
+        aes->controlr.E_D = !encdec;    //encryption
+        aes->controlr.O = mode; //0 ECB 1 CBC 2 OFB 3 CFB 4 CTR 
+
+        //aes->controlr.F = 128; //default; only for CFB and OFB modes; change only for customer-specific apps
+        if (mode > 0) {
+            aes->IV3R = DEU_ENDIAN_SWAP(*(u32 *) iv_arg);
+            aes->IV2R = DEU_ENDIAN_SWAP(*((u32 *) iv_arg + 1));
+            aes->IV1R = DEU_ENDIAN_SWAP(*((u32 *) iv_arg + 2));
+            aes->IV0R = DEU_ENDIAN_SWAP(*((u32 *) iv_arg + 3));
+        };
+
+        while (chunk_cnt >= 16) {
+
+            aes->ID3R = INPUT_ENDIAN_SWAP(*((u32 *) in_arg + (i * 4) + 0));
+            aes->ID2R = INPUT_ENDIAN_SWAP(*((u32 *) in_arg + (i * 4) + 1));
+            aes->ID1R = INPUT_ENDIAN_SWAP(*((u32 *) in_arg + (i * 4) + 2));
+            aes->ID0R = INPUT_ENDIAN_SWAP(*((u32 *) in_arg + (i * 4) + 3));    /* start crypto */
+            
+            while (aes->controlr.BUS) {
+                // this will not take long
+            }
 
-    CRTCL_SECT_START;
-
-    aes_set_key_hw (ctx_arg);
-
-    aes->controlr.E_D = !encdec;    //encryption
-    aes->controlr.O = mode; //0 ECB 1 CBC 2 OFB 3 CFB 4 CTR 
-
-    //aes->controlr.F = 128; //default; only for CFB and OFB modes; change only for customer-specific apps
-    if (mode > 0) {
-        aes->IV3R = DEU_ENDIAN_SWAP(*(u32 *) iv_arg);
-        aes->IV2R = DEU_ENDIAN_SWAP(*((u32 *) iv_arg + 1));
-        aes->IV1R = DEU_ENDIAN_SWAP(*((u32 *) iv_arg + 2));
-        aes->IV0R = DEU_ENDIAN_SWAP(*((u32 *) iv_arg + 3));
-    };
-
-
-    i = 0;
-    while (byte_cnt >= 16) {
+            *((volatile u32 *) out_arg + (i * 4) + 0) = aes->OD3R;
+            *((volatile u32 *) out_arg + (i * 4) + 1) = aes->OD2R;
+            *((volatile u32 *) out_arg + (i * 4) + 2) = aes->OD1R;
+            *((volatile u32 *) out_arg + (i * 4) + 3) = aes->OD0R;
 
-        aes->ID3R = INPUT_ENDIAN_SWAP(*((u32 *) in_arg + (i * 4) + 0));
-        aes->ID2R = INPUT_ENDIAN_SWAP(*((u32 *) in_arg + (i * 4) + 1));
-        aes->ID1R = INPUT_ENDIAN_SWAP(*((u32 *) in_arg + (i * 4) + 2));
-        aes->ID0R = INPUT_ENDIAN_SWAP(*((u32 *) in_arg + (i * 4) + 3));    /* start crypto */
-        
-        while (aes->controlr.BUS) {
-            // this will not take long
+            i++;
+            chunk_cnt -= 16;
         }
 
-        *((volatile u32 *) out_arg + (i * 4) + 0) = aes->OD3R;
-        *((volatile u32 *) out_arg + (i * 4) + 1) = aes->OD2R;
-        *((volatile u32 *) out_arg + (i * 4) + 2) = aes->OD1R;
-        *((volatile u32 *) out_arg + (i * 4) + 3) = aes->OD0R;
+        /* To handle all non-aligned bytes (not aligned to 16B size), only
+           possible in the last chunk */
+        if (chunk_cnt) {
+            u8 temparea[16] = {0,};
 
-        i++;
-        byte_cnt -= 16;
-    }
+            memcpy(temparea, ((u32 *) in_arg + (i * 4)), chunk_cnt);
 
-    /* To handle all non-aligned bytes (not aligned to 16B size) */
-    if (byte_cnt) {
-        u8 temparea[16] = {0,};
+            aes->ID3R = INPUT_ENDIAN_SWAP(*((u32 *) temparea + 0));
+            aes->ID2R = INPUT_ENDIAN_SWAP(*((u32 *) temparea + 1));
+            aes->ID1R = INPUT_ENDIAN_SWAP(*((u32 *) temparea + 2));
+            aes->ID0R = INPUT_ENDIAN_SWAP(*((u32 *) temparea + 3));    /* start crypto */
 
-        memcpy(temparea, ((u32 *) in_arg + (i * 4)), byte_cnt);
+            while (aes->controlr.BUS) {
+            }
 
-        aes->ID3R = INPUT_ENDIAN_SWAP(*((u32 *) temparea + 0));
-        aes->ID2R = INPUT_ENDIAN_SWAP(*((u32 *) temparea + 1));
-        aes->ID1R = INPUT_ENDIAN_SWAP(*((u32 *) temparea + 2));
-        aes->ID0R = INPUT_ENDIAN_SWAP(*((u32 *) temparea + 3));    /* start crypto */
+            *((volatile u32 *) temparea + 0) = aes->OD3R;
+            *((volatile u32 *) temparea + 1) = aes->OD2R;
+            *((volatile u32 *) temparea + 2) = aes->OD1R;
+            *((volatile u32 *) temparea + 3) = aes->OD0R;
 
-        while (aes->controlr.BUS) {
+            memcpy(((u32 *) out_arg + (i * 4)), temparea, chunk_cnt);
         }
 
-        *((volatile u32 *) temparea + 0) = aes->OD3R;
-        *((volatile u32 *) temparea + 1) = aes->OD2R;
-        *((volatile u32 *) temparea + 2) = aes->OD1R;
-        *((volatile u32 *) temparea + 3) = aes->OD0R;
-
-        memcpy(((u32 *) out_arg + (i * 4)), temparea, byte_cnt);
-    }
+        //tc.chen : copy iv_arg back
+        if (mode > 0) {
+            *((u32 *) iv_arg) = DEU_ENDIAN_SWAP(aes->IV3R);
+            *((u32 *) iv_arg + 1) = DEU_ENDIAN_SWAP(aes->IV2R);
+            *((u32 *) iv_arg + 2) = DEU_ENDIAN_SWAP(aes->IV1R);
+            *((u32 *) iv_arg + 3) = DEU_ENDIAN_SWAP(aes->IV0R);
+        }
 
-    //tc.chen : copy iv_arg back
-    if (mode > 0) {
-        *((u32 *) iv_arg) = DEU_ENDIAN_SWAP(aes->IV3R);
-        *((u32 *) iv_arg + 1) = DEU_ENDIAN_SWAP(aes->IV2R);
-        *((u32 *) iv_arg + 2) = DEU_ENDIAN_SWAP(aes->IV1R);
-        *((u32 *) iv_arg + 3) = DEU_ENDIAN_SWAP(aes->IV0R);
+        CRTCL_SECT_END;
     }
-
-    CRTCL_SECT_END;
 }
 
 /*!
@@ -360,6 +386,7 @@ int ctr_rfc3686_aes_set_key (struct crypto_tfm *tfm, const uint8_t *in_key, unsi
 
     ctx->key_length = key_len;
     ctx->use_tweak = 0;
+    ctx->key_gen = atomic_inc_return(&aes_key_gen);
     
     memcpy ((u8 *) (ctx->buf), in_key, key_len);
 
@@ -924,6 +951,7 @@ int xts_aes_set_key_skcipher (struct crypto_skcipher *tfm, const u8 *in_key, uns
 
     ctx->key_length = keylen;
     ctx->use_tweak = 0;
+    ctx->key_gen = atomic_inc_return(&aes_key_gen);
     DPRINTF(0, "ctx @%p, key_len %d, ctx->key_length %d\n", ctx, key_len, ctx->key_length);
     memcpy ((u8 *) (ctx->buf), in_key, keylen);
     memcpy ((u8 *) (ctx->tweakkey), in_key + keylen, keylen);
@@ -105,6 +105,11 @@ static int ltq_deu_probe(struct platform_device *pdev)
     }
 
 #endif
+#if defined(CONFIG_CRYPTO_DEV_ASYNC_AES)
+    if ((ret = lqdeu_async_aes_init (&pdev->dev))) {
+        printk (KERN_ERR "IFX async AES initialization failed!\n");
+    }
+#endif
 #if defined(CONFIG_CRYPTO_DEV_ARC4)
     if ((ret = ifxdeu_init_arc4 ())) {
         printk (KERN_ERR "IFX ARC4 initialization failed!\n");
@@ -149,6 +154,9 @@ static int ltq_deu_remove(struct platform_device *pdev)
     #if defined(CONFIG_CRYPTO_DEV_DES)
     ifxdeu_fini_des ();
     #endif
+    #if defined(CONFIG_CRYPTO_DEV_ASYNC_AES)
+    lqdeu_fini_async_aes ();
+    #endif
     #if defined(CONFIG_CRYPTO_DEV_AES)
     ifxdeu_fini_aes ();
     #endif
@@ -39,6 +39,8 @@
 #include <crypto/algapi.h>
 #include <linux/interrupt.h>
 
+struct device;
+
 #define IFXDEU_ALIGNMENT 16
 
 #define IFX_DEU_BASE_ADDR                       (KSEG1 | 0x1E103100)
@@ -52,6 +54,7 @@
 #define CLC_START IFX_DEU_CLK
 #define IFXDEU_CRA_PRIORITY	300
 #define IFXDEU_COMPOSITE_PRIORITY 400
+#define IFXDEU_ASYNC_PRIORITY	500
 //#define KSEG1                         0xA0000000
 #define IFX_PMU_ENABLE 1
 #define IFX_PMU_DISABLE 0
@@ -115,7 +118,7 @@ int ifxdeu_init_sha1 (void);
 int ifxdeu_init_md5 (void);
 int ifxdeu_init_sha1_hmac (void);
 int ifxdeu_init_md5_hmac (void);
-int __init lqdeu_async_aes_init(void);
+int lqdeu_async_aes_init(struct device *dev);
 int __init lqdeu_async_des_init(void);
 
 void ifxdeu_fini_des (void);
@@ -126,7 +129,7 @@ void ifxdeu_fini_md5 (void);
 void ifxdeu_fini_sha1_hmac (void);
 void ifxdeu_fini_md5_hmac (void);
 void __exit ifxdeu_fini_dma(void);
-void __exit lqdeu_fini_async_aes(void);
+void lqdeu_fini_async_aes(void);
 void __exit lqdeu_fini_async_des(void);
 void __exit deu_fini (void);
 int deu_dma_init (void);
@@ -136,6 +139,9 @@ extern spinlock_t ltq_deu_hash_lock;
 #define CRTCL_SECT_HASH_START       spin_lock_irqsave(&ltq_deu_hash_lock, flag)
 #define CRTCL_SECT_HASH_END         spin_unlock_irqrestore(&ltq_deu_hash_lock, flag)
 
+/* SHA1/MD5 blocks fed to the hash engine per critical section */
+#define HASH_MAX_BLOCKS_PER_LOCK    16
+
 
 #define DEU_WAKELIST_INIT(queue) \
     init_waitqueue_head(&queue)
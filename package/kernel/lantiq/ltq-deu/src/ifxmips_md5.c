@@ -44,6 +44,7 @@
 #include <linux/string.h>
 #include <linux/crypto.h>
 #include <linux/types.h>
+#include <crypto/md5.h>
 #include <crypto/internal/hash.h>
 #include <asm/byteorder.h>
 
@@ -58,10 +59,6 @@
 #error "Plaform Unknwon!"
 #endif
 
-#define MD5_DIGEST_SIZE     16
-#define MD5_HMAC_BLOCK_SIZE 64
-#define MD5_BLOCK_WORDS     16
-#define MD5_HASH_WORDS      4
 #define HASH_START   IFX_HASH_CON
 
 //#define CRYPTO_DEBUG
@@ -81,58 +78,67 @@ struct md5_ctx {
 
 extern int disable_deudma;
 
-/*! \fn static void md5_transform(u32 *hash, u32 const *in)
+/*! \fn static void md5_transform(struct md5_ctx *mctx, u32 const *in, unsigned int blocks)
  *  \ingroup IFX_MD5_FUNCTIONS
- *  \brief main interface to md5 hardware   
- *  \param hash current hash value  
- *  \param in 64-byte block of input  
-*/                                 
-static void md5_transform(struct md5_ctx *mctx, u32 *hash, u32 const *in)
+ *  \brief main interface to md5 hardware
+ *  \param mctx md5 context
+ *  \param in consecutive 64-byte blocks of input
+ *  \param blocks number of blocks
+*/
+static void md5_transform(struct md5_ctx *mctx, u32 const *in, unsigned int blocks)
 {
     int i;
     volatile struct deu_hash_t *hashs = (struct deu_hash_t *) HASH_START;
     unsigned long flag;
+    unsigned int n;
 
-    CRTCL_SECT_HASH_START;
+    while (blocks) {
+        n = min_t(unsigned int, blocks, HASH_MAX_BLOCKS_PER_LOCK);
+        blocks -= n;
 
-    MD5_HASH_INIT;
+        CRTCL_SECT_HASH_START;
 
-    if (mctx->started) { 
-        hashs->D1R = *((u32 *) hash + 0);
-        hashs->D2R = *((u32 *) hash + 1);
-        hashs->D3R = *((u32 *) hash + 2);
-        hashs->D4R = *((u32 *) hash + 3);
-    }
+        MD5_HASH_INIT;
 
-    for (i = 0; i < 16; i++) {
-        hashs->MR = in[i];
-//      printk("in[%d]: %08x\n", i, in[i]);
-    };
+        if (mctx->started) {
+            hashs->D1R = *((u32 *) mctx->hash + 0);
+            hashs->D2R = *((u32 *) mctx->hash + 1);
+            hashs->D3R = *((u32 *) mctx->hash + 2);
+            hashs->D4R = *((u32 *) mctx->hash + 3);
+        }
 
-    //wait for processing
-    while (hashs->controlr.BSY) {
-        // this will not take long
-    }
+        while (n--) {
+            for (i = 0; i < 16; i++) {
+                hashs->MR = in[i];
+            };
+
+            //wait for processing
+            while (hashs->controlr.BSY) {
+                // this will not take long
+            }
 
-    *((u32 *) hash + 0) = hashs->D1R;
-    *((u32 *) hash + 1) = hashs->D2R;
-    *((u32 *) hash + 2) = hashs->D3R;
-    *((u32 *) hash + 3) = hashs->D4R;
+            in += 16;
+        }
 
-    CRTCL_SECT_HASH_END;
+        *((u32 *) mctx->hash + 0) = hashs->D1R;
+        *((u32 *) mctx->hash + 1) = hashs->D2R;
+        *((u32 *) mctx->hash + 2) = hashs->D3R;
+        *((u32 *) mctx->hash + 3) = hashs->D4R;
 
-    mctx->started = 1;
+        mctx->started = 1;
+
+        CRTCL_SECT_HASH_END;
+    }
 }
 
 /*! \fn static inline void md5_transform_helper(struct md5_ctx *ctx)
  *  \ingroup IFX_MD5_FUNCTIONS
- *  \brief interfacing function for md5_transform()   
- *  \param ctx crypto context  
-*/                                 
+ *  \brief interfacing function for md5_transform()
+ *  \param ctx crypto context
+*/
 static inline void md5_transform_helper(struct md5_ctx *ctx)
 {
-    //le32_to_cpu_array(ctx->block, sizeof(ctx->block) / sizeof(u32));
-    md5_transform(ctx, ctx->hash, ctx->block);
+    md5_transform(ctx, ctx->block, 1);
 }
 
 /*! \fn static void md5_init(struct crypto_tfm *tfm)
@@ -177,6 +183,15 @@ static int md5_update(struct shash_desc *desc, const u8 *data, unsigned int len)
     data += avail;
     len -= avail;
 
+    /* aligned input is fed to the engine in place, several blocks at once */
+    if (IS_ALIGNED((unsigned long)data, sizeof(u32)) && len >= sizeof(mctx->block)) {
+        unsigned int blocks = len / sizeof(mctx->block);
+
+        md5_transform(mctx, (const u32 *)data, blocks);
+        data += blocks * sizeof(mctx->block);
+        len -= blocks * sizeof(mctx->block);
+    }
+
     while (len >= sizeof(mctx->block)) {
         memcpy(mctx->block, data, sizeof(mctx->block));
         md5_transform_helper(mctx);
@@ -215,7 +230,7 @@ static int md5_final(struct shash_desc *desc, u8 *out)
     mctx->block[14] = le32_to_cpu(mctx->byte_count << 3);
     mctx->block[15] = le32_to_cpu(mctx->byte_count >> 29);
 
-    md5_transform(mctx, mctx->hash, mctx->block);                                                 
+    md5_transform_helper(mctx);
 
     memcpy(out, mctx->hash, MD5_DIGEST_SIZE);
 
@@ -225,6 +240,50 @@ static int md5_final(struct shash_desc *desc, u8 *out)
     return 0;
 }
 
+/*! \fn static int md5_export(struct shash_desc *desc, void *out)
+ *  \ingroup IFX_MD5_FUNCTIONS
+ *  \brief save the partial hash state in the generic md5_state layout
+ *  \param desc md5 descriptor
+ *  \param out struct md5_state to fill
+*/
+static int md5_export(struct shash_desc *desc, void *out)
+{
+    struct md5_ctx *mctx = shash_desc_ctx(desc);
+    struct md5_state *state = out;
+    static const u32 md5_iv[MD5_HASH_WORDS] = { MD5_H0, MD5_H1, MD5_H2, MD5_H3 };
+    int i;
+
+    /* the hardware digest words are the little endian digest bytes */
+    for (i = 0; i < MD5_HASH_WORDS; i++)
+        state->hash[i] = mctx->started ?
+            le32_to_cpu((__force __le32) mctx->hash[i]) : md5_iv[i];
+
+    memcpy(state->block, mctx->block, sizeof(state->block));
+    state->byte_count = mctx->byte_count;
+    return 0;
+}
+
+/*! \fn static int md5_import(struct shash_desc *desc, const void *in)
+ *  \ingroup IFX_MD5_FUNCTIONS
+ *  \brief restore a partial hash state saved by md5_export()
+ *  \param desc md5 descriptor
+ *  \param in struct md5_state to load
+*/
+static int md5_import(struct shash_desc *desc, const void *in)
+{
+    struct md5_ctx *mctx = shash_desc_ctx(desc);
+    const struct md5_state *state = in;
+    int i;
+
+    for (i = 0; i < MD5_HASH_WORDS; i++)
+        mctx->hash[i] = (__force u32) cpu_to_le32(state->hash[i]);
+
+    memcpy(mctx->block, state->block, sizeof(mctx->block));
+    mctx->byte_count = state->byte_count;
+    mctx->started = state->byte_count >= MD5_HMAC_BLOCK_SIZE;
+    return 0;
+}
+
 /*
  * \brief MD5 function mappings
 */
@@ -233,7 +292,10 @@ static struct shash_alg ifxdeu_md5_alg = {
     .init               =       md5_init,
     .update             =       md5_update,
     .final              =       md5_final,
+    .export             =       md5_export,
+    .import             =       md5_import,
     .descsize           =       sizeof(struct md5_ctx),
+    .statesize          =       sizeof(struct md5_state),
     .base               =       {
                 .cra_name       =       "md5",
                 .cra_driver_name=       "ifxdeu-md5",
@@ -387,7 +387,9 @@ static struct shash_alg ifxdeu_md5_hmac_alg = {
     .base               =       {
         .cra_name       =       "hmac(md5)",
         .cra_driver_name=       "ifxdeu-md5_hmac",
-        .cra_priority   =       400,
+        /* keeps the request state in the tfm and has no export/import,
+           rank it below hmac(ifxdeu-md5) from the hmac template */
+        .cra_priority   =       200,
         .cra_ctxsize    =       sizeof(struct md5_hmac_ctx),
         .cra_flags      =       CRYPTO_ALG_TYPE_HASH | CRYPTO_ALG_KERN_DRIVER_ONLY,
         .cra_blocksize  =       MD5_HMAC_BLOCK_SIZE,
@@ -84,60 +84,73 @@ struct sha1_ctx {
 	int started;
         u64 count;
 	u32 hash[5];
-        u32 state[5];
         u8 buffer[64];
 };
 
 extern int disable_deudma;
 
-/*! \fn static void sha1_transform1 (u32 *state, const u32 *in)
+/*! \fn static void sha1_transform1 (struct sha1_ctx *sctx, const u32 *in, unsigned int blocks)
  *  \ingroup IFX_SHA1_FUNCTIONS
- *  \brief main interface to sha1 hardware   
- *  \param state current state 
- *  \param in 64-byte block of input  
-*/                                 
-static void sha1_transform1 (struct sha1_ctx *sctx, u32 *state, const u32 *in)
+ *  \brief main interface to sha1 hardware
+ *  \param sctx sha1 context
+ *  \param in consecutive 64-byte blocks of input
+ *  \param blocks number of blocks
+*/
+static void sha1_transform1 (struct sha1_ctx *sctx, const u32 *in, unsigned int blocks)
 {
     int i = 0;
     volatile struct deu_hash_t *hashs = (struct deu_hash_t *) HASH_START;
     unsigned long flag;
+    unsigned int n;
 
-    CRTCL_SECT_HASH_START;
+    while (blocks) {
+        n = min_t(unsigned int, blocks, HASH_MAX_BLOCKS_PER_LOCK);
+        blocks -= n;
 
-    SHA_HASH_INIT;
+        CRTCL_SECT_HASH_START;
 
-    /* For context switching purposes, the previous hash output
-     * is loaded back into the output register 
-    */
-    if (sctx->started) {
-        hashs->D1R = *((u32 *) sctx->hash + 0);
-        hashs->D2R = *((u32 *) sctx->hash + 1);
-        hashs->D3R = *((u32 *) sctx->hash + 2);
-        hashs->D4R = *((u32 *) sctx->hash + 3);
-        hashs->D5R = *((u32 *) sctx->hash + 4);
-    }
+        SHA_HASH_INIT;
+
+        /* For context switching purposes, the previous hash output
+         * is loaded back into the output register
+        */
+        if (sctx->started) {
+            hashs->D1R = *((u32 *) sctx->hash + 0);
+            hashs->D2R = *((u32 *) sctx->hash + 1);
+            hashs->D3R = *((u32 *) sctx->hash + 2);
+            hashs->D4R = *((u32 *) sctx->hash + 3);
+            hashs->D5R = *((u32 *) sctx->hash + 4);
+        }
+
+        /* the engine chains the blocks, the state only has to be
+         * restored once per critical section
+        */
+        while (n--) {
+            for (i = 0; i < 16; i++) {
+                hashs->MR = in[i];
+            };
 
-    for (i = 0; i < 16; i++) {
-        hashs->MR = in[i];
-    };
+            //wait for processing
+            while (hashs->controlr.BSY) {
+                // this will not take long
+            }
+
+            in += 16;
+        }
 
-    //wait for processing
-    while (hashs->controlr.BSY) {
-        // this will not take long
+        /* For context switching purposes, the output is saved into a
+         * context struct which can be used later on
+        */
+        *((u32 *) sctx->hash + 0) = hashs->D1R;
+        *((u32 *) sctx->hash + 1) = hashs->D2R;
+        *((u32 *) sctx->hash + 2) = hashs->D3R;
+        *((u32 *) sctx->hash + 3) = hashs->D4R;
+        *((u32 *) sctx->hash + 4) = hashs->D5R;
+
+        sctx->started = 1;
+
+        CRTCL_SECT_HASH_END;
     }
-   
-    /* For context switching purposes, the output is saved into a 
-     * context struct which can be used later on 
-    */
-    *((u32 *) sctx->hash + 0) = hashs->D1R;
-    *((u32 *) sctx->hash + 1) = hashs->D2R;
-    *((u32 *) sctx->hash + 2) = hashs->D3R;
-    *((u32 *) sctx->hash + 3) = hashs->D4R;
-    *((u32 *) sctx->hash + 4) = hashs->D5R;
-
-    sctx->started = 1;
-
-    CRTCL_SECT_HASH_END;
 }
 
 /*! \fn static void sha1_init1(struct crypto_tfm *tfm)
@@ -165,16 +178,19 @@ static int sha1_update(struct shash_desc * desc, const u8 *data,
             unsigned int len)
 {
     struct sha1_ctx *sctx = shash_desc_ctx(desc);
-    unsigned int i, j;
+    unsigned int i, j, blocks;
 
     j = (sctx->count >> 3) & 0x3f;
-    sctx->count += len << 3;
+    sctx->count += (u64)len << 3;
 
     if ((j + len) > 63) {
         memcpy (&sctx->buffer[j], data, (i = 64 - j));
-        sha1_transform1 (sctx, sctx->state, (const u32 *)sctx->buffer);
-        for (; i + 63 < len; i += 64) {
-            sha1_transform1 (sctx, sctx->state, (const u32 *)&data[i]);
+        sha1_transform1 (sctx, (const u32 *)sctx->buffer, 1);
+
+        blocks = (len - i) / 64;
+        if (blocks) {
+            sha1_transform1 (sctx, (const u32 *)&data[i], blocks);
+            i += blocks * 64;
         }
 
         j = 0;
@@ -235,6 +251,50 @@ static int sha1_final(struct shash_desc *desc, u8 *out)
     return 0;
 }
 
+/*! \fn static int sha1_export(struct shash_desc *desc, void *out)
+ *  \ingroup IFX_SHA1_FUNCTIONS
+ *  \brief save the partial hash state in the generic sha1_state layout
+ *  \param desc sha1 descriptor
+ *  \param out struct sha1_state to fill
+*/
+static int sha1_export(struct shash_desc *desc, void *out)
+{
+    struct sha1_ctx *sctx = shash_desc_ctx(desc);
+    struct sha1_state *state = out;
+    static const u32 sha1_iv[5] = { SHA1_H0, SHA1_H1, SHA1_H2, SHA1_H3, SHA1_H4 };
+    int i;
+
+    /* the hardware digest words are the big endian digest bytes */
+    for (i = 0; i < 5; i++)
+        state->state[i] = sctx->started ?
+            be32_to_cpu((__force __be32) sctx->hash[i]) : sha1_iv[i];
+
+    state->count = sctx->count >> 3;
+    memcpy(state->buffer, sctx->buffer, sizeof(state->buffer));
+    return 0;
+}
+
+/*! \fn static int sha1_import(struct shash_desc *desc, const void *in)
+ *  \ingroup IFX_SHA1_FUNCTIONS
+ *  \brief restore a partial hash state saved by sha1_export()
+ *  \param desc sha1 descriptor
+ *  \param in struct sha1_state to load
+*/
+static int sha1_import(struct shash_desc *desc, const void *in)
+{
+    struct sha1_ctx *sctx = shash_desc_ctx(desc);
+    const struct sha1_state *state = in;
+    int i;
+
+    for (i = 0; i < 5; i++)
+        sctx->hash[i] = (__force u32) cpu_to_be32(state->state[i]);
+
+    sctx->started = state->count >= SHA1_HMAC_BLOCK_SIZE;
+    sctx->count = state->count << 3;
+    memcpy(sctx->buffer, state->buffer, sizeof(sctx->buffer));
+    return 0;
+}
+
 /* 
  * \brief SHA1 function mappings
 */
@@ -243,6 +303,8 @@ static struct shash_alg ifxdeu_sha1_alg = {
         .init           =       sha1_init1,
         .update         =       sha1_update,
         .final          =       sha1_final,
+        .export         =       sha1_export,
+        .import         =       sha1_import,
         .descsize       =       sizeof(struct sha1_ctx),
         .statesize      =       sizeof(struct sha1_state),
         .base           =       {
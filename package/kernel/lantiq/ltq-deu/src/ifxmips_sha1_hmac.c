@@ -409,7 +409,9 @@ static struct shash_alg ifxdeu_sha1_hmac_alg = {
     .base               =       {
         .cra_name       =       "hmac(sha1)",
         .cra_driver_name=       "ifxdeu-sha1_hmac",
-        .cra_priority   =       400,
+        /* keeps the request state in the tfm and has no export/import,
+           rank it below hmac(ifxdeu-sha1) from the hmac template */
+        .cra_priority   =       200,
         .cra_ctxsize    =       sizeof(struct sha1_hmac_ctx),
         .cra_flags      =       CRYPTO_ALG_TYPE_HASH | CRYPTO_ALG_KERN_DRIVER_ONLY,
         .cra_blocksize  =       SHA1_HMAC_BLOCK_SIZE,
@@ -35,6 +35,7 @@
 #include <linux/netdevice.h>
 #include <linux/platform_device.h>
 #include <linux/of_device.h>
+#include <linux/hashtable.h>
 
 #include "ifxmips_ptm_vdsl.h"
 #include <lantiq_soc.h>
@@ -76,6 +77,7 @@ static int ptm_stop(struct net_device *);
   static unsigned int ptm_poll(int, unsigned int);
   static int ptm_napi_poll(struct napi_struct *, int);
 static int ptm_hard_start_xmit(struct sk_buff *, struct net_device *);
+static u16 ptm_select_queue(struct net_device *, struct sk_buff *, struct net_device *);
 static int ptm_ioctl(struct net_device *, struct ifreq *, int);
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5,6,0)
 static void ptm_tx_timeout(struct net_device *);
@@ -86,6 +88,11 @@ static void ptm_tx_timeout(struct net_device *, unsigned int txqueue);
 static inline struct sk_buff* alloc_skb_rx(void);
 static inline struct sk_buff* alloc_skb_tx(unsigned int);
 static inline struct sk_buff *get_skb_pointer(unsigned int);
+static inline struct sk_buff *get_tx_skb_pointer(unsigned int);
+static inline int tx_shadow_add(struct sk_buff *, unsigned int, unsigned int);
+static void ptm_wake_tx_queues(struct net_device *);
+static int ptm_tx_reclaim(void);
+static void ptm_tx_reset_queues(struct net_device *);
 static inline int get_tx_desc(unsigned int, unsigned int *);
 
 /*
@@ -97,6 +104,7 @@ static irqreturn_t mailbox_irq_handler(int, void *);
  *  Tasklet to Handle Swap Descriptors
  */
 static void do_swap_desc_tasklet(unsigned long);
+static void do_tx_reclaim_tasklet(unsigned long);
 
 
 /*
@@ -118,6 +126,7 @@ static struct net_device_ops g_ptm_netdev_ops = {
     .ndo_open            = ptm_open,
     .ndo_stop            = ptm_stop,
     .ndo_start_xmit      = ptm_hard_start_xmit,
+    .ndo_select_queue    = ptm_select_queue,
     .ndo_validate_addr   = eth_validate_addr,
     .ndo_set_mac_address = eth_mac_addr,
     .ndo_do_ioctl        = ptm_ioctl,
@@ -129,10 +138,40 @@ static char *g_net_dev_name[1] = {"dsl0"};
 
 static int g_ptm_prio_queue_map[8];
 
+/*
+ *  TX buffers passed to PPE without copying carry no skb pointer in their
+ *  headroom. They are tracked here by data pointer instead, as PPE swaps
+ *  buffers between CPU TX, QoS queue and swap descriptors.
+ */
+#define TX_SHADOW_NUM                   (CPU_TO_WAN_TX_DESC_NUM + WAN_TX_DESC_NUM_TOTAL + WAN_SWAP_DESC_NUM)
+#define TX_SHADOW_HASH_BITS             8
+
+struct tx_shadow_entry {
+    struct hlist_node   node;
+    unsigned int        dataptr;
+    unsigned int        qid;
+    unsigned int        len;
+    struct sk_buff     *skb;
+};
+
+static struct tx_shadow_entry g_tx_shadow[TX_SHADOW_NUM];
+static HLIST_HEAD(g_tx_shadow_free);
+static DEFINE_HASHTABLE(g_tx_shadow_hash, TX_SHADOW_HASH_BITS);
+static DEFINE_SPINLOCK(g_tx_shadow_lock);
+
+/*
+ *  Number of buffers queued to each PPE QoS queue and not yet returned.
+ *  Each PPE queue is exposed as a netdev TX queue and stopped once it has
+ *  as many buffers pending as it has descriptors.
+ */
+static unsigned int g_tx_queue_pending[8];
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5,9,0)
 static DECLARE_TASKLET(g_swap_desc_tasklet, do_swap_desc_tasklet, 0);
+static DECLARE_TASKLET(g_tx_reclaim_tasklet, do_tx_reclaim_tasklet, 0);
 #else
 static DECLARE_TASKLET_OLD(g_swap_desc_tasklet, do_swap_desc_tasklet);
+static DECLARE_TASKLET_OLD(g_tx_reclaim_tasklet, do_tx_reclaim_tasklet);
 #endif
 
 
@@ -181,7 +220,7 @@ static int ptm_open(struct net_device *dev)
 
     IFX_REG_W32_MASK(0, 1, MBOX_IGU1_IER);
 
-    netif_start_queue(dev);
+    netif_tx_start_all_queues(dev);
 
     return 0;
 }
@@ -194,7 +233,9 @@ static int ptm_stop(struct net_device *dev)
 
     napi_disable(&g_ptm_priv_data.itf[0].napi);
 
-    netif_stop_queue(dev);
+    netif_tx_disable(dev);
+    tasklet_kill(&g_tx_reclaim_tasklet);
+    ptm_tx_reset_queues(dev);
 
     return 0;
 }
@@ -285,7 +326,11 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
     volatile struct tx_descriptor *desc;
     struct tx_descriptor reg_desc = {0};
     struct sk_buff *skb_to_free;
+    struct netdev_queue *txq;
     unsigned int byteoff;
+    unsigned int dataptr;
+    unsigned int qid;
+    int i;
 
     ASSERT(dev == g_net_dev[0], "incorrect device");
 
@@ -294,11 +339,22 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
         goto PTM_HARD_START_XMIT_FAIL;
     }
 
+    /*  pad short frames, PPE always sends at least ETH_ZLEN bytes */
+    if ( skb_put_padto(skb, ETH_ZLEN) ) {
+        g_ptm_priv_data.itf[0].stats.tx_dropped++;
+        return 0;
+    }
+
+    qid = skb_get_queue_mapping(skb);
+    txq = netdev_get_tx_queue(dev, qid);
+
     /*  allocate descriptor */
     desc_base = get_tx_desc(0, &f_full);
     if ( f_full ) {
-        netif_trans_update(dev);
-        netif_stop_queue(dev);
+        /*  CPU TX descriptors are shared by all queues */
+        for ( i = 0; i < dev->real_num_tx_queues; i++ )
+            netdev_get_tx_queue(dev, i)->trans_start = jiffies;
+        netif_tx_stop_all_queues(dev);
 
         IFX_REG_W32_MASK(0, 1 << 17, MBOX_IGU1_ISRC);
         IFX_REG_W32_MASK(0, 1 << 17, MBOX_IGU1_IER);
@@ -307,44 +363,41 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
         goto PTM_HARD_START_XMIT_FAIL;
     desc = &CPU_TO_WAN_TX_DESC_BASE[desc_base];
 
-    byteoff = (unsigned int)skb->data & (DATA_BUFFER_ALIGNMENT - 1);
-    if ( skb_headroom(skb) < sizeof(struct sk_buff *) + byteoff || skb_cloned(skb) ) {
-        struct sk_buff *new_skb;
-
-        ASSERT(skb_headroom(skb) >= sizeof(struct sk_buff *) + byteoff, "skb_headroom(skb) < sizeof(struct sk_buff *) + byteoff");
-        ASSERT(!skb_cloned(skb), "skb is cloned");
-
-        new_skb = alloc_skb_tx(skb->len);
-        if ( new_skb == NULL ) {
-            dbg("no memory");
-            goto ALLOC_SKB_TX_FAIL;
-        }
-        skb_put(new_skb, skb->len);
-        memcpy(new_skb->data, skb->data, skb->len);
-        dev_kfree_skb_any(skb);
-        skb = new_skb;
-        byteoff = (unsigned int)skb->data & (DATA_BUFFER_ALIGNMENT - 1);
-        /*  write back to physical memory   */
-        dma_cache_wback((unsigned long)skb->data, skb->len);
-    }
-
     /* make the skb unowned */
     skb_orphan(skb);
 
-    *(struct sk_buff **)((unsigned int)skb->data - byteoff - sizeof(struct sk_buff *)) = skb;
-    /*  write back to physical memory   */
-    dma_cache_wback((unsigned long)skb->data - byteoff - sizeof(struct sk_buff *), skb->len + byteoff + sizeof(struct sk_buff *));
+    byteoff = (unsigned int)skb->data & (DATA_BUFFER_ALIGNMENT - 1);
+    dataptr = (unsigned int)skb->data & (0x0FFFFFFF ^ (DATA_BUFFER_ALIGNMENT - 1));
 
-    /*  free previous skb   */
-    skb_to_free = get_skb_pointer(desc->dataptr);
+    /*  free previous skb before the new one is published, a clone of it
+     *  shares the data pointer */
+    skb_to_free = get_tx_skb_pointer(desc->dataptr);
+    desc->dataptr = 0;
     if ( skb_to_free != NULL )
         dev_kfree_skb_any(skb_to_free);
 
+    /*  account before the buffer can be released again   */
+    netdev_tx_sent_queue(txq, skb->len);
+
+    /*  can't run full, pending buffers are limited per queue   */
+    if ( tx_shadow_add(skb, dataptr, qid) != 0 ) {
+        dbg("no tx shadow entry");
+        netdev_tx_completed_queue(txq, 1, skb->len);
+        goto PTM_HARD_START_XMIT_FAIL;
+    }
+
+    /*  no new frame on a stopped queue releases its buffers    */
+    if ( netif_xmit_stopped(txq) )
+        tasklet_schedule(&g_tx_reclaim_tasklet);
+
+    /*  write back frame data to physical memory   */
+    dma_cache_wback((unsigned long)skb->data, skb->len);
+
     /*  update descriptor   */
     reg_desc.small   = 0;
-    reg_desc.dataptr = (unsigned int)skb->data & (0x0FFFFFFF ^ (DATA_BUFFER_ALIGNMENT - 1));
-    reg_desc.datalen = skb->len < ETH_ZLEN ? ETH_ZLEN : skb->len;
-    reg_desc.qid     = g_ptm_prio_queue_map[skb->priority > 7 ? 7 : skb->priority];
+    reg_desc.dataptr = dataptr;
+    reg_desc.datalen = skb->len;
+    reg_desc.qid     = qid;
     reg_desc.byteoff = byteoff;
     reg_desc.own     = 1;
     reg_desc.c       = 1;
@@ -359,17 +412,25 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
     wmb();
     *(volatile unsigned int *)desc = *(unsigned int *)&reg_desc;
 
-    netif_trans_update(dev);
+    txq->trans_start = jiffies;
 
     return 0;
 
-ALLOC_SKB_TX_FAIL:
 PTM_HARD_START_XMIT_FAIL:
     dev_kfree_skb_any(skb);
     g_ptm_priv_data.itf[0].stats.tx_dropped++;
     return 0;
 }
 
+static u16 ptm_select_queue(struct net_device *dev, struct sk_buff *skb, struct net_device *sb_dev)
+{
+    /*  leave queue selection to mqprio if configured   */
+    if ( netdev_get_num_tc(dev) )
+        return netdev_pick_tx(dev, skb, sb_dev);
+
+    return g_ptm_prio_queue_map[skb->priority > 7 ? 7 : skb->priority];
+}
+
 static int ptm_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd)
 {
     ASSERT(dev == g_net_dev[0], "incorrect device");
@@ -470,8 +531,12 @@ static void ptm_tx_timeout(struct net_device *dev, unsigned int txqueue)
     /*  disable TX irq, release skb when sending new packet */
     IFX_REG_W32_MASK(1 << 17, 0, MBOX_IGU1_IER);
 
-    /*  wake up TX queue    */
-    netif_wake_queue(dev);
+    /*  a stopped queue sends nothing new, release what PPE is done with  */
+    ptm_tx_reclaim();
+    tasklet_hi_schedule(&g_swap_desc_tasklet);
+
+    /*  wake up TX queues with free descriptors */
+    ptm_wake_tx_queues(dev);
 
     return;
 }
@@ -533,6 +598,179 @@ static inline struct sk_buff *get_skb_pointer(unsigned int dataptr)
     return skb;
 }
 
+static inline int tx_desc_available(void)
+{
+    return CPU_TO_WAN_TX_DESC_BASE[g_ptm_priv_data.itf[0].tx_desc_pos].own == 0;
+}
+
+/*  called with g_tx_shadow_lock held   */
+static void __ptm_wake_tx_queues(struct net_device *dev)
+{
+    int i;
+
+    if ( !tx_desc_available() )
+        return;
+
+    for ( i = 0; i < dev->real_num_tx_queues; i++ )
+        if ( g_tx_queue_pending[i] < WAN_TX_DESC_NUM )
+            netif_tx_wake_queue(netdev_get_tx_queue(dev, i));
+}
+
+static void ptm_wake_tx_queues(struct net_device *dev)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&g_tx_shadow_lock, flags);
+    __ptm_wake_tx_queues(dev);
+    spin_unlock_irqrestore(&g_tx_shadow_lock, flags);
+}
+
+/*
+ *  Release the buffers of CPU TX descriptors PPE has given back. Otherwise
+ *  they are only released when the descriptor is reused by a later frame.
+ *  Called with all TX queues locked, returns the number of descriptors
+ *  still held by PPE.
+ */
+static int ptm_tx_reclaim(void)
+{
+    volatile struct tx_descriptor *desc;
+    struct sk_buff *skb;
+    int held = 0;
+    int i;
+
+    for ( i = 0; i < CPU_TO_WAN_TX_DESC_NUM; i++ ) {
+        desc = &CPU_TO_WAN_TX_DESC_BASE[i];
+        if ( desc->own ) {
+            held++;
+            continue;
+        }
+        if ( desc->dataptr == 0 )
+            continue;
+
+        skb = get_tx_skb_pointer(desc->dataptr);
+        desc->dataptr = 0;
+        if ( skb != NULL )
+            dev_kfree_skb_any(skb);
+    }
+
+    return held;
+}
+
+static void do_tx_reclaim_tasklet(unsigned long arg)
+{
+    struct net_device *dev = g_net_dev[0];
+    int held;
+    int i;
+
+    netif_tx_lock(dev);
+    held = ptm_tx_reclaim();
+    netif_tx_unlock(dev);
+
+    ptm_wake_tx_queues(dev);
+
+    /*  look again once PPE returns another descriptor  */
+    for ( i = 0; held && i < dev->real_num_tx_queues; i++ )
+        if ( netif_tx_queue_stopped(netdev_get_tx_queue(dev, i)) ) {
+            IFX_REG_W32_MASK(0, 1 << 17, MBOX_IGU1_IER);
+            break;
+        }
+}
+
+/*
+ *  Buffers still pending when the queues are reset no longer count
+ *  towards BQL, they are released with a length of 0.
+ */
+static void ptm_tx_reset_queues(struct net_device *dev)
+{
+    struct tx_shadow_entry *entry;
+    unsigned long flags;
+    int i;
+
+    spin_lock_irqsave(&g_tx_shadow_lock, flags);
+    hash_for_each(g_tx_shadow_hash, i, entry, node)
+        entry->len = 0;
+    for ( i = 0; i < dev->num_tx_queues; i++ )
+        netdev_tx_reset_queue(netdev_get_tx_queue(dev, i));
+    spin_unlock_irqrestore(&g_tx_shadow_lock, flags);
+}
+
+/*  called with g_tx_shadow_lock held   */
+static inline void ptm_tx_done(unsigned int qid, unsigned int len)
+{
+    struct net_device *dev = g_net_dev[0];
+    struct netdev_queue *txq;
+
+    g_tx_queue_pending[qid]--;
+
+    /*  buffers are released after the netdev is gone on removal    */
+    if ( dev == NULL )
+        return;
+
+    txq = netdev_get_tx_queue(dev, qid);
+    netdev_tx_completed_queue(txq, 1, len);
+
+    if ( netif_tx_queue_stopped(txq) && g_tx_queue_pending[qid] < WAN_TX_DESC_NUM && tx_desc_available() )
+        netif_tx_wake_queue(txq);
+}
+
+static inline int tx_shadow_add(struct sk_buff *skb, unsigned int dataptr, unsigned int qid)
+{
+    struct tx_shadow_entry *entry;
+    unsigned long flags;
+
+    spin_lock_irqsave(&g_tx_shadow_lock, flags);
+    if ( hlist_empty(&g_tx_shadow_free) ) {
+        spin_unlock_irqrestore(&g_tx_shadow_lock, flags);
+        return -ENOMEM;
+    }
+    entry = hlist_entry(g_tx_shadow_free.first, struct tx_shadow_entry, node);
+    hlist_del(&entry->node);
+    entry->dataptr = dataptr;
+    entry->qid = qid;
+    entry->len = skb->len;
+    entry->skb = skb;
+    hash_add(g_tx_shadow_hash, &entry->node, dataptr);
+
+    if ( ++g_tx_queue_pending[qid] >= WAN_TX_DESC_NUM )
+        netif_tx_stop_queue(netdev_get_tx_queue(g_net_dev[0], qid));
+    spin_unlock_irqrestore(&g_tx_shadow_lock, flags);
+
+    return 0;
+}
+
+static inline struct sk_buff *get_tx_skb_pointer(unsigned int dataptr)
+{
+    struct tx_shadow_entry *entry, *oldest = NULL;
+    struct sk_buff *skb = NULL;
+    unsigned long flags;
+    unsigned int key;
+
+    if ( dataptr == 0 )
+        return NULL;
+
+    key = dataptr & (0x0FFFFFFF ^ (DATA_BUFFER_ALIGNMENT - 1));
+
+    /*  the same data may be queued more than once (clones), release the
+     *  oldest entry, new ones are added at the head of the chain */
+    spin_lock_irqsave(&g_tx_shadow_lock, flags);
+    hash_for_each_possible(g_tx_shadow_hash, entry, node, key)
+        if ( entry->dataptr == key )
+            oldest = entry;
+    if ( oldest != NULL ) {
+        skb = oldest->skb;
+        ptm_tx_done(oldest->qid, oldest->len);
+        hash_del(&oldest->node);
+        hlist_add_head(&oldest->node, &g_tx_shadow_free);
+    }
+    spin_unlock_irqrestore(&g_tx_shadow_lock, flags);
+
+    if ( skb != NULL )
+        return skb;
+
+    /*  swap buffer or private copy, pointer is stored in headroom  */
+    return get_skb_pointer(dataptr);
+}
+
 static inline int get_tx_desc(unsigned int itf, unsigned int *f_full)
 {
     int desc_base = -1;
@@ -582,7 +820,7 @@ static irqreturn_t mailbox_irq_handler(int irq, void *dev_id)
             }
 	    if (isr & BIT(17)) {
                 IFX_REG_W32_MASK(1 << 17, 0, MBOX_IGU1_IER);
-                netif_wake_queue(g_net_dev[0]);
+                tasklet_schedule(&g_tx_reclaim_tasklet);
         	}
 
     return IRQ_HANDLED;
@@ -603,7 +841,7 @@ static void do_swap_desc_tasklet(unsigned long arg)
         if ( ++g_ptm_priv_data.itf[0].tx_swap_desc_pos == WAN_SWAP_DESC_NUM )
             g_ptm_priv_data.itf[0].tx_swap_desc_pos = 0;
 
-        skb = get_skb_pointer(desc->dataptr);
+        skb = get_tx_skb_pointer(desc->dataptr);
         if ( skb != NULL )
             dev_kfree_skb_any(skb);
 
@@ -663,6 +901,12 @@ static inline int init_priv_data(void)
 
     memset(&g_ptm_priv_data, 0, sizeof(g_ptm_priv_data));
 
+    memset(g_tx_queue_pending, 0, sizeof(g_tx_queue_pending));
+    hash_init(g_tx_shadow_hash);
+    INIT_HLIST_HEAD(&g_tx_shadow_free);
+    for ( i = 0; i < ARRAY_SIZE(g_tx_shadow); i++ )
+        hlist_add_head(&g_tx_shadow[i].node, &g_tx_shadow_free);
+
     {
         int max_packet_priority = ARRAY_SIZE(g_ptm_prio_queue_map);
         int tx_num_q;
@@ -883,20 +1127,20 @@ static inline void clear_tables(void)
     }
 
     for ( i = 0; i < CPU_TO_WAN_TX_DESC_NUM; i++ ) {
-        skb = get_skb_pointer(CPU_TO_WAN_TX_DESC_BASE[i].dataptr);
+        skb = get_tx_skb_pointer(CPU_TO_WAN_TX_DESC_BASE[i].dataptr);
         if ( skb != NULL )
             dev_kfree_skb_any(skb);
     }
 
     for ( j = 0; j < 8; j++ )
         for ( i = 0; i < WAN_TX_DESC_NUM; i++ ) {
-            skb = get_skb_pointer(WAN_TX_DESC_BASE(j)[i].dataptr);
+            skb = get_tx_skb_pointer(WAN_TX_DESC_BASE(j)[i].dataptr);
             if ( skb != NULL )
                 dev_kfree_skb_any(skb);
         }
 
     for ( i = 0; i < WAN_SWAP_DESC_NUM; i++ ) {
-        skb = get_skb_pointer(WAN_SWAP_DESC_BASE[i].dataptr);
+        skb = get_tx_skb_pointer(WAN_SWAP_DESC_BASE[i].dataptr);
         if ( skb != NULL )
             dev_kfree_skb_any(skb);
     }
@@ -952,6 +1196,10 @@ static int ptm_showtime_exit(void)
 
 	g_showtime = 0;
 
+	netif_tx_lock_bh(g_net_dev[0]);
+	ptm_tx_reset_queues(g_net_dev[0]);
+	netif_tx_unlock_bh(g_net_dev[0]);
+
 	//  TODO: ReTX clean state
 	g_xdata_addr = NULL;
 
@@ -995,7 +1243,7 @@ static int ltq_ptm_probe(struct platform_device *pdev)
     }
 
     for ( i = 0; i < ARRAY_SIZE(g_net_dev); i++ ) {
-        g_net_dev[i] = alloc_netdev(0, g_net_dev_name[i], NET_NAME_UNKNOWN, ether_setup);
+        g_net_dev[i] = alloc_netdev_mqs(0, g_net_dev_name[i], NET_NAME_UNKNOWN, ether_setup, __ETH_WAN_TX_QUEUE_NUM, 1);
         if ( g_net_dev[i] == NULL )
             goto ALLOC_NETDEV_FAIL;
         ptm_setup(g_net_dev[i], i);
@@ -239,6 +239,18 @@ endef
 $(eval $(call KernelPackage,crypto-echainiv))
 
 
+define KernelPackage/crypto-engine
+  TITLE:=Crypto hardware request queue engine
+  HIDDEN:=1
+  KCONFIG:=CONFIG_CRYPTO_ENGINE
+  FILES:=$(LINUX_DIR)/crypto/crypto_engine.ko
+  AUTOLOAD:=$(call AutoLoad,09,crypto_engine)
+  $(call AddDepends/crypto)
+endef
+
+$(eval $(call KernelPackage,crypto-engine))
+
+
 define KernelPackage/crypto-essiv
   TITLE:=ESSIV support for block encryption
   DEPENDS:=+kmod-crypto-authenc
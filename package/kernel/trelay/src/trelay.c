@@ -19,6 +19,13 @@
 #include <linux/netdevice.h>
 #include <linux/rtnetlink.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/interrupt.h>
+#include <linux/u64_stats_sync.h>
+
+/* frames queued per CPU before the batch is flushed without waiting
+ * for the end of the NAPI cycle */
+#define TRELAY_BATCH_MAX	64
 
 #define trelay_log(loglevel, tr, fmt, ...) \
 	printk(loglevel "trelay: %s <-> %s: " fmt "\n", \
@@ -27,34 +34,217 @@
 static LIST_HEAD(trelay_devs);
 static struct dentry *debugfs_dir;
 
+struct trelay_stats {
+	u64 rx_packets;
+	u64 rx_bytes;
+	u64 tx_packets;
+	u64 tx_bytes;
+	u64 dropped;
+	struct u64_stats_sync syncp;
+};
+
 struct trelay {
 	struct list_head list;
 	struct net_device *dev1, *dev2;
+	/* indexed by the receiving device: 0 for dev1, 1 for dev2 */
+	struct trelay_stats __percpu *stats[2];
 	struct dentry *debugfs;
 	int to_remove;
 	char name[];
 };
 
+struct trelay_batch {
+	struct sk_buff_head queue;
+	struct tasklet_struct tasklet;
+};
+
+struct trelay_skb_cb {
+	struct trelay_stats __percpu *stats;
+};
+
+#define TRELAY_SKB_CB(skb) ((struct trelay_skb_cb *)(skb)->cb)
+
+static DEFINE_PER_CPU(struct trelay_batch, trelay_batch);
+
+static void trelay_xmit(struct sk_buff *skb)
+{
+	struct trelay_stats *stats;
+	unsigned int len = skb->len;
+	int ret;
+
+	stats = this_cpu_ptr(TRELAY_SKB_CB(skb)->stats);
+	ret = dev_queue_xmit(skb);
+
+	u64_stats_update_begin(&stats->syncp);
+	if (!net_xmit_eval(ret)) {
+		stats->tx_packets++;
+		stats->tx_bytes += len;
+	} else {
+		stats->dropped++;
+	}
+	u64_stats_update_end(&stats->syncp);
+}
+
+static void trelay_flush(struct trelay_batch *batch)
+{
+	struct sk_buff *skb;
+
+	while ((skb = __skb_dequeue(&batch->queue)) != NULL)
+		trelay_xmit(skb);
+}
+
+static void trelay_batch_tasklet(unsigned long data)
+{
+	trelay_flush((struct trelay_batch *)data);
+}
+
 rx_handler_result_t trelay_handle_frame(struct sk_buff **pskb)
 {
+	struct trelay_batch *batch;
+	struct trelay_stats *stats;
 	struct net_device *dev;
 	struct sk_buff *skb = *pskb;
+	struct trelay *tr;
+	int idx;
 
-	dev = rcu_dereference(skb->dev->rx_handler_data);
-	if (!dev)
+	tr = rcu_dereference(skb->dev->rx_handler_data);
+	if (!tr)
 		return RX_HANDLER_PASS;
 
 	if (skb->protocol == htons(ETH_P_PAE))
 		return RX_HANDLER_PASS;
 
+	idx = skb->dev != tr->dev1;
+	dev = idx ? tr->dev1 : tr->dev2;
+	stats = this_cpu_ptr(tr->stats[idx]);
+
 	skb_push(skb, ETH_HLEN);
+
+	u64_stats_update_begin(&stats->syncp);
+	stats->rx_packets++;
+	stats->rx_bytes += skb->len;
+	u64_stats_update_end(&stats->syncp);
+
+	/*
+	 * GRO merged frames are passed on as they are. If the egress
+	 * device can't handle the GSO type, the core segments them on
+	 * transmit.
+	 */
+	if (unlikely(!is_skb_forwardable(dev, skb))) {
+		u64_stats_update_begin(&stats->syncp);
+		stats->dropped++;
+		u64_stats_update_end(&stats->syncp);
+		kfree_skb(skb);
+		return RX_HANDLER_CONSUMED;
+	}
+
 	skb->dev = dev;
 	skb_forward_csum(skb);
-	dev_queue_xmit(skb);
+	TRELAY_SKB_CB(skb)->stats = tr->stats[idx];
+
+	batch = this_cpu_ptr(&trelay_batch);
+	__skb_queue_tail(&batch->queue, skb);
+	if (skb_queue_len(&batch->queue) >= TRELAY_BATCH_MAX)
+		trelay_flush(batch);
+	else
+		tasklet_schedule(&batch->tasklet);
 
 	return RX_HANDLER_CONSUMED;
 }
 
+/* wait for all frames queued by a relay to be transmitted */
+static void trelay_sync_batches(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		tasklet_kill(&per_cpu(trelay_batch, cpu).tasklet);
+}
+
+static void trelay_free_stats(struct trelay *tr)
+{
+	free_percpu(tr->stats[0]);
+	free_percpu(tr->stats[1]);
+}
+
+static int trelay_alloc_stats(struct trelay *tr)
+{
+	int i, cpu;
+
+	for (i = 0; i < ARRAY_SIZE(tr->stats); i++) {
+		tr->stats[i] = alloc_percpu(struct trelay_stats);
+		if (!tr->stats[i]) {
+			trelay_free_stats(tr);
+			return -ENOMEM;
+		}
+
+		for_each_possible_cpu(cpu)
+			u64_stats_init(&per_cpu_ptr(tr->stats[i], cpu)->syncp);
+	}
+
+	return 0;
+}
+
+static void trelay_read_stats(struct trelay_stats __percpu *pstats,
+			      struct trelay_stats *sum)
+{
+	int cpu;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		struct trelay_stats *stats = per_cpu_ptr(pstats, cpu);
+		u64 rx_packets, rx_bytes, tx_packets, tx_bytes, dropped;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin_irq(&stats->syncp);
+			rx_packets = stats->rx_packets;
+			rx_bytes = stats->rx_bytes;
+			tx_packets = stats->tx_packets;
+			tx_bytes = stats->tx_bytes;
+			dropped = stats->dropped;
+		} while (u64_stats_fetch_retry_irq(&stats->syncp, start));
+
+		sum->rx_packets += rx_packets;
+		sum->rx_bytes += rx_bytes;
+		sum->tx_packets += tx_packets;
+		sum->tx_bytes += tx_bytes;
+		sum->dropped += dropped;
+	}
+}
+
+static int trelay_stats_show(struct seq_file *s, void *v)
+{
+	struct trelay *tr = s->private;
+	struct trelay_stats sum;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tr->stats); i++) {
+		trelay_read_stats(tr->stats[i], &sum);
+		seq_printf(s, "%s -> %s: rx_packets %llu rx_bytes %llu "
+			   "tx_packets %llu tx_bytes %llu dropped %llu\n",
+			   i ? tr->dev2->name : tr->dev1->name,
+			   i ? tr->dev1->name : tr->dev2->name,
+			   sum.rx_packets, sum.rx_bytes,
+			   sum.tx_packets, sum.tx_bytes, sum.dropped);
+	}
+
+	return 0;
+}
+
+static int trelay_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, trelay_stats_show, inode->i_private);
+}
+
+static const struct file_operations fops_stats = {
+	.owner = THIS_MODULE,
+	.open = trelay_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int trelay_open(struct inode *inode, struct file *file)
 {
 	file->private_data = inode->i_private;
@@ -69,14 +259,16 @@ static int trelay_do_remove(struct trelay *tr)
 	 * to prevent dangling pointer in file->private_data */
 	debugfs_remove_recursive(tr->debugfs);
 
-	dev_put(tr->dev1);
-	dev_put(tr->dev2);
-
 	netdev_rx_handler_unregister(tr->dev1);
 	netdev_rx_handler_unregister(tr->dev2);
+	trelay_sync_batches();
+
+	dev_put(tr->dev1);
+	dev_put(tr->dev2);
 
 	trelay_log(KERN_INFO, tr, "stopped");
 
+	trelay_free_stats(tr);
 	kfree(tr);
 
 	return 0;
@@ -156,6 +348,11 @@ static int trelay_do_add(char *name, char *devn1, char *devn2)
 	if (!tr)
 		return -ENOMEM;
 
+	if (trelay_alloc_stats(tr)) {
+		kfree(tr);
+		return -ENOMEM;
+	}
+
 	rtnl_lock();
 	rcu_read_lock();
 
@@ -171,11 +368,15 @@ static int trelay_do_add(char *name, char *devn1, char *devn2)
 	if (!dev1 || !dev2)
 		goto out;
 
-	ret = netdev_rx_handler_register(dev1, trelay_handle_frame, dev2);
+	strcpy(tr->name, name);
+	tr->dev1 = dev1;
+	tr->dev2 = dev2;
+
+	ret = netdev_rx_handler_register(dev1, trelay_handle_frame, tr);
 	if (ret < 0)
 		goto out;
 
-	ret = netdev_rx_handler_register(dev2, trelay_handle_frame, dev1);
+	ret = netdev_rx_handler_register(dev2, trelay_handle_frame, tr);
 	if (ret < 0) {
 		netdev_rx_handler_unregister(dev1);
 		goto out;
@@ -184,22 +385,22 @@ static int trelay_do_add(char *name, char *devn1, char *devn2)
 	dev_hold(dev1);
 	dev_hold(dev2);
 
-	strcpy(tr->name, name);
-	tr->dev1 = dev1;
-	tr->dev2 = dev2;
 	list_add_tail(&tr->list, &trelay_devs);
 
 	trelay_log(KERN_INFO, tr, "started");
 
 	tr->debugfs = debugfs_create_dir(name, debugfs_dir);
 	debugfs_create_file("remove", S_IWUSR, tr->debugfs, tr, &fops_remove);
+	debugfs_create_file("stats", S_IRUSR, tr->debugfs, tr, &fops_stats);
 	ret = 0;
 
 out:
 	rcu_read_unlock();
 	rtnl_unlock();
-	if (ret < 0)
+	if (ret < 0) {
+		trelay_free_stats(tr);
 		kfree(tr);
+	}
 
 	return ret;
 }
@@ -256,7 +457,15 @@ static struct notifier_block tr_dev_notifier = {
 
 static int __init trelay_init(void)
 {
-	int ret;
+	struct trelay_batch *batch;
+	int ret, cpu;
+
+	for_each_possible_cpu(cpu) {
+		batch = per_cpu_ptr(&trelay_batch, cpu);
+		__skb_queue_head_init(&batch->queue);
+		tasklet_init(&batch->tasklet, trelay_batch_tasklet,
+			     (unsigned long)batch);
+	}
 
 	debugfs_dir = debugfs_create_dir("trelay", NULL);
 	if (!debugfs_dir)
@@ -286,6 +495,8 @@ static void __exit trelay_exit(void)
 		trelay_do_remove(tr);
 	rtnl_unlock();
 
+	trelay_sync_batches();
+
 	debugfs_remove_recursive(debugfs_dir);
 }
 
@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "dsl_cpe_control.h"
@@ -43,6 +44,7 @@
 #define IOCTL(type, request) \
 	type out; \
 	memset(&out, 0, sizeof(type)); \
+	ioctl_count++; \
 	if (ioctl(fd, request, &out)) \
 		return;
 
@@ -50,6 +52,7 @@
 	type out; \
 	memset(&out, 0, sizeof(type)); \
 	out.nDirection = dir; \
+	ioctl_count++; \
 	if (ioctl(fd, request, &out)) \
 		return;
 
@@ -58,6 +61,7 @@
 	memset(&out, 0, sizeof(type)); \
 	out.nDirection = dir; \
 	out.nDeltDataType = delt; \
+	ioctl_count++; \
 	if (ioctl(fd, request, &out)) \
 		return;
 
@@ -133,9 +137,42 @@ enum {
 	PSTATE_MAP_L3,
 };
 
+/* Interval in ms for refreshing the line state and counters */
+#define CACHE_REFRESH_INTERVAL 10000
+
+typedef void (*cache_fill_t)(int fd, int fd_mei);
+
+/* A section of a reply, rendered into its own blob_buf and replayed into
+ * the ubus replies until it is refreshed.
+ */
+struct cache {
+	const char *name;
+	cache_fill_t fill;
+	/* refresh on access once older than this (ms), 0 if refreshed elsewhere */
+	unsigned int max_age;
+
+	struct blob_buf buf;
+	bool valid;
+	struct timespec updated;
+	unsigned int ioctls;
+	unsigned int duration;
+	unsigned int refreshes;
+};
+
+struct call_stats {
+	unsigned int calls;
+	unsigned int ioctls;
+};
+
 static DSL_CPE_ThreadCtrl_t thread;
 static struct ubus_context *ctx;
 static struct blob_buf b;
+static unsigned int ioctl_count;
+
+/* state of the last counters refresh, used to detect retrains */
+static bool line_up;
+static uint32_t line_uptime;
+static vector_t line_vector;
 
 static inline void m_null() {
 	blobmsg_add_field(&b, BLOBMSG_TYPE_UNSPEC, "", NULL, 0);
@@ -342,7 +379,7 @@ static void version_information(int fd) {
 	m_str("driver_version", out.data.DSL_DriverVersionMeiBsp);
 }
 
-static void line_state(int fd) {
+static void line_state(int fd, bool *up) {
 	IOCTL(DSL_LineState_t, DSL_FIO_LINE_STATE_GET)
 
 	int map = LSTATE_MAP_UNKNOWN;
@@ -398,13 +435,15 @@ static void line_state(int fd) {
 	if (map != LSTATE_MAP_UNKNOWN )
 		m_u32("state_num", map);
 
-	m_bool("up", out.data.nLineState == DSL_LINESTATE_SHOWTIME_TC_SYNC);
+	*up = out.data.nLineState == DSL_LINESTATE_SHOWTIME_TC_SYNC;
+	m_bool("up", *up);
 }
 
-static void pm_channel_counters_showtime(int fd) {
+static void pm_channel_counters_showtime(int fd, uint32_t *uptime) {
 	IOCTL_DIR(DSL_PM_ChannelCounters_t, DSL_FIO_PM_CHANNEL_COUNTERS_SHOWTIME_GET, DSL_NEAR_END);
 
-	m_u32("uptime", out.interval.nElapsedTime);
+	*uptime = out.interval.nElapsedTime;
+	m_u32("uptime", *uptime);
 }
 
 static void g997_line_inventory(int fd) {
@@ -793,12 +832,8 @@ static void describe_mode(standard_t standard, profile_t profile, vector_t vecto
 	m_str("mode", buf);
 }
 
-static int line_statistics(struct ubus_context *ctx, struct ubus_object *obj,
-                   struct ubus_request_data *req, const char *method,
-                   struct blob_attr *msg)
-{
+static int open_devices(int *fd_mei) {
 	int fd;
-	void *c, *c2;
 
 #ifndef INCLUDE_DSL_CPE_API_DANUBE
 	fd = open(DSL_CPE_DEVICE_NAME "/0", O_RDWR, 0644);
@@ -806,88 +841,36 @@ static int line_statistics(struct ubus_context *ctx, struct ubus_object *obj,
 	fd = open(DSL_CPE_DEVICE_NAME, O_RDWR, 0644);
 #endif
 	if (fd < 0)
-		return UBUS_STATUS_UNKNOWN_ERROR;
-
-	blob_buf_init(&b, 0);
-
-	c = blobmsg_open_table(&b, "bits");
-	c2 = blobmsg_open_table(&b, "downstream");
-	g977_get_bit_allocation(fd, DSL_DOWNSTREAM);
-	blobmsg_close_table(&b, c2);
-	c2 = blobmsg_open_table(&b, "upstream");
-	g977_get_bit_allocation(fd, DSL_UPSTREAM);
-	blobmsg_close_table(&b, c2);
-	blobmsg_close_table(&b, c);
-
-	c = blobmsg_open_table(&b, "snr");
-	c2 = blobmsg_open_table(&b, "downstream");
-	g977_get_snr(fd, DSL_DOWNSTREAM);
-	blobmsg_close_table(&b, c2);
-	c2 = blobmsg_open_table(&b, "upstream");
-	g977_get_snr(fd, DSL_UPSTREAM);
-	blobmsg_close_table(&b, c2);
-	blobmsg_close_table(&b, c);
+		return fd;
 
-	c = blobmsg_open_table(&b, "qln");
-	c2 = blobmsg_open_table(&b, "downstream");
-	g977_get_qln(fd, DSL_DOWNSTREAM);
-	blobmsg_close_table(&b, c2);
-	c2 = blobmsg_open_table(&b, "upstream");
-	g977_get_qln(fd, DSL_UPSTREAM);
-	blobmsg_close_table(&b, c2);
-	blobmsg_close_table(&b, c);
-
-	c = blobmsg_open_table(&b, "hlog");
-	c2 = blobmsg_open_table(&b, "downstream");
-	g977_get_hlog(fd, DSL_DOWNSTREAM);
-	blobmsg_close_table(&b, c2);
-	c2 = blobmsg_open_table(&b, "upstream");
-	g977_get_hlog(fd, DSL_UPSTREAM);
-	blobmsg_close_table(&b, c2);
-	blobmsg_close_table(&b, c);
+#ifdef INCLUDE_DSL_CPE_API_VRX
+	*fd_mei = open(DSL_CPE_DSL_LOW_DEV "/0", O_RDWR, 0644);
+#else
+	*fd_mei = -1;
+#endif
 
-	ubus_send_reply(ctx, req, b.head);
+	return fd;
+}
 
+static void close_devices(int fd, int fd_mei) {
+	if (fd_mei >= 0)
+		close(fd_mei);
 	close(fd);
-
-	return 0;
 }
 
-static int metrics(struct ubus_context *ctx, struct ubus_object *obj,
-		   struct ubus_request_data *req, const char *method,
-		   struct blob_attr *msg)
-{
-	int fd, fd_mei;
-	void *c, *c2;
+/* Static line information, only changes on retrain */
+static void fill_info(int fd, int fd_mei) {
+	void *c;
 	standard_t standard = STD_UNKNOWN;
 	profile_t profile = PROFILE_UNKNOWN;
 	vector_t vector = VECTOR_UNKNOWN;
 
-#ifndef INCLUDE_DSL_CPE_API_DANUBE
-	fd = open(DSL_CPE_DEVICE_NAME "/0", O_RDWR, 0644);
-#else
-	fd = open(DSL_CPE_DEVICE_NAME, O_RDWR, 0644);
-#endif
-	if (fd < 0)
-		return UBUS_STATUS_UNKNOWN_ERROR;
-
-#ifdef INCLUDE_DSL_CPE_API_VRX
-	fd_mei = open(DSL_CPE_DSL_LOW_DEV "/0", O_RDWR, 0644);
-#else
-	fd_mei = -1;
-#endif
-
-	blob_buf_init(&b, 0);
-
 	version_information(fd);
-	line_state(fd);
-	pm_channel_counters_showtime(fd);
 
 	c = blobmsg_open_table(&b, "atu_c");
 	g997_line_inventory(fd);
 	blobmsg_close_table(&b, c);
 
-	g997_power_management_status(fd);
 	g997_xtu_system_enabling(fd, &standard);
 
 	if (standard == STD_G_993_2) {
@@ -897,8 +880,21 @@ static int metrics(struct ubus_context *ctx, struct ubus_object *obj,
 
 	describe_mode(standard, profile, vector);
 
+	line_vector = vector;
+}
+
+/* Line state and counters, refreshed periodically */
+static void fill_counters(int fd, int fd_mei) {
+	void *c, *c2;
+	bool up = false;
+	uint32_t uptime = 0;
+
+	line_state(fd, &up);
+	pm_channel_counters_showtime(fd, &uptime);
+	g997_power_management_status(fd);
+
 	c = blobmsg_open_table(&b, "upstream");
-	switch (vector) {
+	switch (line_vector) {
 	case VECTOR_OFF:
 		m_bool("vector", false);
 		break;
@@ -914,7 +910,7 @@ static int metrics(struct ubus_context *ctx, struct ubus_object *obj,
 	blobmsg_close_table(&b, c);
 
 	c = blobmsg_open_table(&b, "downstream");
-	switch (vector) {
+	switch (line_vector) {
 	case VECTOR_OFF:
 		m_bool("vector", false);
 		break;
@@ -944,7 +940,7 @@ static int metrics(struct ubus_context *ctx, struct ubus_object *obj,
 	blobmsg_close_table(&b, c2);
 	blobmsg_close_table(&b, c);
 
-	switch (vector) {
+	switch (line_vector) {
 	case VECTOR_ON_DS:
 	case VECTOR_ON_DS_US:
 		c = blobmsg_open_table(&b, "erb");
@@ -955,18 +951,272 @@ static int metrics(struct ubus_context *ctx, struct ubus_object *obj,
 		break;
 	};
 
+	line_up = up;
+	line_uptime = uptime;
+}
+
+/* Per-tone tables, only change on retrain */
+static void fill_tones(int fd, int fd_mei) {
+	void *c, *c2;
+
+	c = blobmsg_open_table(&b, "bits");
+	c2 = blobmsg_open_table(&b, "downstream");
+	g977_get_bit_allocation(fd, DSL_DOWNSTREAM);
+	blobmsg_close_table(&b, c2);
+	c2 = blobmsg_open_table(&b, "upstream");
+	g977_get_bit_allocation(fd, DSL_UPSTREAM);
+	blobmsg_close_table(&b, c2);
+	blobmsg_close_table(&b, c);
+
+	c = blobmsg_open_table(&b, "qln");
+	c2 = blobmsg_open_table(&b, "downstream");
+	g977_get_qln(fd, DSL_DOWNSTREAM);
+	blobmsg_close_table(&b, c2);
+	c2 = blobmsg_open_table(&b, "upstream");
+	g977_get_qln(fd, DSL_UPSTREAM);
+	blobmsg_close_table(&b, c2);
+	blobmsg_close_table(&b, c);
+
+	c = blobmsg_open_table(&b, "hlog");
+	c2 = blobmsg_open_table(&b, "downstream");
+	g977_get_hlog(fd, DSL_DOWNSTREAM);
+	blobmsg_close_table(&b, c2);
+	c2 = blobmsg_open_table(&b, "upstream");
+	g977_get_hlog(fd, DSL_UPSTREAM);
+	blobmsg_close_table(&b, c2);
+	blobmsg_close_table(&b, c);
+}
+
+static void fill_snr(int fd, int fd_mei) {
+	void *c, *c2;
+
+	c = blobmsg_open_table(&b, "snr");
+	c2 = blobmsg_open_table(&b, "downstream");
+	g977_get_snr(fd, DSL_DOWNSTREAM);
+	blobmsg_close_table(&b, c2);
+	c2 = blobmsg_open_table(&b, "upstream");
+	g977_get_snr(fd, DSL_UPSTREAM);
+	blobmsg_close_table(&b, c2);
+	blobmsg_close_table(&b, c);
+}
+
+static struct cache cache_info = { .name = "info", .fill = fill_info };
+static struct cache cache_counters = { .name = "counters", .fill = fill_counters };
+static struct cache cache_tones = { .name = "tones", .fill = fill_tones };
+static struct cache cache_snr = { .name = "snr", .fill = fill_snr, .max_age = CACHE_REFRESH_INTERVAL };
+
+static struct cache *caches[] = {
+	&cache_info,
+	&cache_counters,
+	&cache_tones,
+	&cache_snr,
+};
+
+static struct call_stats stats_metrics, stats_statistics;
+
+static unsigned int timespec_diff_ms(const struct timespec *a, const struct timespec *b) {
+	return (a->tv_sec - b->tv_sec) * 1000 + (a->tv_nsec - b->tv_nsec) / 1000000;
+}
+
+static unsigned int cache_age(struct cache *cache) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_diff_ms(&now, &cache->updated);
+}
+
+static void cache_update(struct cache *cache, int fd, int fd_mei) {
+	struct timespec start;
+	unsigned int count = ioctl_count;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	blob_buf_init(&b, 0);
+	cache->fill(fd, fd_mei);
+
+	blob_buf_init(&cache->buf, 0);
+	blob_put_raw(&cache->buf, blob_data(b.head), blob_len(b.head));
+
+	clock_gettime(CLOCK_MONOTONIC, &cache->updated);
+	cache->duration = timespec_diff_ms(&cache->updated, &start);
+	cache->ioctls = ioctl_count - count;
+	cache->refreshes++;
+	cache->valid = true;
+}
+
+/* Refreshes the counters and, if the line retrained since the last
+ * refresh, the static line information. The per-tone tables are dropped
+ * on retrain and fetched again on the next request.
+ */
+static void cache_refresh(void) {
+	bool was_up = line_up;
+	uint32_t was_uptime = line_uptime;
+	int fd, fd_mei;
+
+	fd = open_devices(&fd_mei);
+	if (fd < 0)
+		return;
+
+	cache_update(&cache_counters, fd, fd_mei);
+
+	if (!cache_info.valid || line_up != was_up || line_uptime < was_uptime) {
+		cache_update(&cache_info, fd, fd_mei);
+		/* the vector state may have changed */
+		cache_update(&cache_counters, fd, fd_mei);
+		cache_tones.valid = false;
+		cache_snr.valid = false;
+	}
+
+	close_devices(fd, fd_mei);
+}
+
+static void refresh_timer_cb(struct uloop_timeout *t) {
+	cache_refresh();
+	uloop_timeout_set(t, CACHE_REFRESH_INTERVAL);
+}
+
+static struct uloop_timeout refresh_timer = {
+	.cb = refresh_timer_cb,
+};
+
+static bool cache_stale(struct cache *cache) {
+	return !cache->valid || (cache->max_age && cache_age(cache) >= cache->max_age);
+}
+
+/* Brings the given caches up to date, returns false if the device could
+ * not be opened.
+ */
+static bool cache_prepare(struct cache **list, size_t n) {
+	int fd, fd_mei;
+	bool stale = false;
+
+	if (!cache_counters.valid)
+		cache_refresh();
+
+	if (!cache_counters.valid)
+		return false;
+
+	for (size_t i = 0; i < n; i++)
+		stale |= cache_stale(list[i]);
+
+	if (!stale)
+		return true;
+
+	fd = open_devices(&fd_mei);
+	if (fd < 0)
+		return false;
+
+	for (size_t i = 0; i < n; i++)
+		if (cache_stale(list[i]))
+			cache_update(list[i], fd, fd_mei);
+
+	close_devices(fd, fd_mei);
+
+	return true;
+}
+
+static void cache_reply(struct ubus_context *ctx, struct ubus_request_data *req,
+			struct cache **list, size_t n) {
+	void *c;
+
+	blob_buf_init(&b, 0);
+
+	for (size_t i = 0; i < n; i++)
+		blob_put_raw(&b, blob_data(list[i]->buf.head), blob_len(list[i]->buf.head));
+
+	// age of each section in seconds
+	c = blobmsg_open_table(&b, "age");
+	for (size_t i = 0; i < n; i++)
+		m_u32(list[i]->name, cache_age(list[i]) / 1000);
+	blobmsg_close_table(&b, c);
+
 	ubus_send_reply(ctx, req, b.head);
+}
 
-	if (fd_mei >= 0)
-		close(fd_mei);
-	close(fd);
+static int line_statistics(struct ubus_context *ctx, struct ubus_object *obj,
+                   struct ubus_request_data *req, const char *method,
+                   struct blob_attr *msg)
+{
+	struct cache *list[] = { &cache_tones, &cache_snr };
+	unsigned int count = ioctl_count;
+
+	if (!cache_prepare(list, ARRAY_SIZE(list)))
+		return UBUS_STATUS_UNKNOWN_ERROR;
+
+	cache_reply(ctx, req, list, ARRAY_SIZE(list));
+
+	stats_statistics.calls++;
+	stats_statistics.ioctls += ioctl_count - count;
+
+	return 0;
+}
+
+static int metrics(struct ubus_context *ctx, struct ubus_object *obj,
+		   struct ubus_request_data *req, const char *method,
+		   struct blob_attr *msg)
+{
+	struct cache *list[] = { &cache_info, &cache_counters };
+	unsigned int count = ioctl_count;
+
+	if (!cache_prepare(list, ARRAY_SIZE(list)))
+		return UBUS_STATUS_UNKNOWN_ERROR;
+
+	cache_reply(ctx, req, list, ARRAY_SIZE(list));
+
+	stats_metrics.calls++;
+	stats_metrics.ioctls += ioctl_count - count;
+
+	return 0;
+}
+
+static void m_call_stats(const char *id, const struct call_stats *stats) {
+	void *c = blobmsg_open_table(&b, id);
+
+	m_u32("calls", stats->calls);
+	m_u32("ioctls", stats->ioctls);
+	if (stats->calls)
+		m_double("ioctls_per_call", (double)stats->ioctls / stats->calls);
+
+	blobmsg_close_table(&b, c);
+}
+
+static int cache_status(struct ubus_context *ctx, struct ubus_object *obj,
+			struct ubus_request_data *req, const char *method,
+			struct blob_attr *msg)
+{
+	void *c, *c2;
+
+	blob_buf_init(&b, 0);
+
+	c = blobmsg_open_table(&b, "sections");
+	for (size_t i = 0; i < ARRAY_SIZE(caches); i++) {
+		c2 = blobmsg_open_table(&b, caches[i]->name);
+		m_bool("valid", caches[i]->valid);
+		if (caches[i]->valid)
+			m_u32("age", cache_age(caches[i]) / 1000);
+		m_u32("refreshes", caches[i]->refreshes);
+		m_u32("ioctls", caches[i]->ioctls);
+		m_u32("duration_ms", caches[i]->duration);
+		blobmsg_close_table(&b, c2);
+	}
+	blobmsg_close_table(&b, c);
+
+	c = blobmsg_open_table(&b, "calls");
+	m_call_stats("metrics", &stats_metrics);
+	m_call_stats("statistics", &stats_statistics);
+	blobmsg_close_table(&b, c);
+
+	m_u32("ioctls", ioctl_count);
+
+	ubus_send_reply(ctx, req, b.head);
 
 	return 0;
 }
 
 static const struct ubus_method dsl_methods[] = {
 	UBUS_METHOD_NOARG("metrics", metrics),
-	UBUS_METHOD_NOARG("statistics", line_statistics)
+	UBUS_METHOD_NOARG("statistics", line_statistics),
+	UBUS_METHOD_NOARG("cache", cache_status)
 };
 
 static struct ubus_object_type dsl_object_type =
@@ -999,6 +1249,9 @@ void ubus_init() {
 
 	ubus_add_uloop(ctx);
 
+	// first refresh as soon as the loop runs
+	uloop_timeout_set(&refresh_timer, 0);
+
 	DSL_CPE_ThreadInit(&thread, "ubus", ubus_main, DSL_CPE_PIPE_STACK_SIZE, DSL_CPE_PIPE_PRIORITY, 0, 0);
 }
 
@@ -1010,4 +1263,7 @@ void ubus_deinit() {
 	uloop_done();
 
 	DSL_CPE_ThreadShutdown(&thread, 1000);
+
+	for (size_t i = 0; i < ARRAY_SIZE(caches); i++)
+		blob_buf_free(&caches[i]->buf);
 }
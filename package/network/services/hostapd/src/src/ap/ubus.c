@@ -44,6 +44,101 @@ struct ubus_banned_client {
 	u8 addr[ETH_ALEN];
 };
 
+/* time to wait for the subscribers' notify_response verdict (ms) */
+#define HOSTAPD_UBUS_VERDICT_TIMEOUT	100
+#define HOSTAPD_UBUS_VERDICT_TTL	1000
+
+struct ubus_verdict {
+	struct avl_node avl;
+	u8 addr[ETH_ALEN];
+	u8 valid;
+	u8 pending;
+	int resp[HOSTAPD_UBUS_TYPE_MAX];
+	struct os_reltime expire[HOSTAPD_UBUS_TYPE_MAX];
+};
+
+struct ubus_verdict_req {
+	struct ubus_notify_request nreq;
+	struct dl_list list;
+	struct hostapd_data *hapd;
+	struct os_reltime sent;
+	enum hostapd_ubus_event_type type;
+	u8 addr[ETH_ALEN];
+	int resp;
+};
+
+/* the first entries match enum hostapd_ubus_event_type */
+enum {
+	HOSTAPD_UBUS_EV_PROBE,
+	HOSTAPD_UBUS_EV_AUTH,
+	HOSTAPD_UBUS_EV_ASSOC,
+	HOSTAPD_UBUS_EV_MGMT,
+	HOSTAPD_UBUS_EV_DISASSOC,
+	HOSTAPD_UBUS_EV_DEAUTH,
+	HOSTAPD_UBUS_EV_LOCAL_DEAUTH,
+	HOSTAPD_UBUS_EV_INACTIVE_DEAUTH,
+	HOSTAPD_UBUS_EV_KEY_MISMATCH,
+	HOSTAPD_UBUS_EV_STA_AUTHORIZED,
+	HOSTAPD_UBUS_EV_BEACON_REPORT,
+	HOSTAPD_UBUS_EV_LINK_MEASUREMENT,
+	HOSTAPD_UBUS_EV_RADAR_DETECTED,
+	HOSTAPD_UBUS_EV_BSS_TR_RESPONSE,
+	HOSTAPD_UBUS_EV_BSS_TR_QUERY,
+	HOSTAPD_UBUS_EV_VLAN_ADD,
+	HOSTAPD_UBUS_EV_VLAN_REMOVE,
+	__HOSTAPD_UBUS_EV_MAX
+};
+
+#define HOSTAPD_UBUS_EV_ALL	(BIT(__HOSTAPD_UBUS_EV_MAX) - 1)
+
+static const char * const event_names[__HOSTAPD_UBUS_EV_MAX] = {
+	[HOSTAPD_UBUS_EV_PROBE] = "probe",
+	[HOSTAPD_UBUS_EV_AUTH] = "auth",
+	[HOSTAPD_UBUS_EV_ASSOC] = "assoc",
+	[HOSTAPD_UBUS_EV_MGMT] = "mgmt",
+	[HOSTAPD_UBUS_EV_DISASSOC] = "disassoc",
+	[HOSTAPD_UBUS_EV_DEAUTH] = "deauth",
+	[HOSTAPD_UBUS_EV_LOCAL_DEAUTH] = "local-deauth",
+	[HOSTAPD_UBUS_EV_INACTIVE_DEAUTH] = "inactive-deauth",
+	[HOSTAPD_UBUS_EV_KEY_MISMATCH] = "key-mismatch",
+	[HOSTAPD_UBUS_EV_STA_AUTHORIZED] = "sta-authorized",
+	[HOSTAPD_UBUS_EV_BEACON_REPORT] = "beacon-report",
+	[HOSTAPD_UBUS_EV_LINK_MEASUREMENT] = "link-measurement-report",
+	[HOSTAPD_UBUS_EV_RADAR_DETECTED] = "radar-detected",
+	[HOSTAPD_UBUS_EV_BSS_TR_RESPONSE] = "bss-transition-response",
+	[HOSTAPD_UBUS_EV_BSS_TR_QUERY] = "bss-transition-query",
+	[HOSTAPD_UBUS_EV_VLAN_ADD] = "vlan_add",
+	[HOSTAPD_UBUS_EV_VLAN_REMOVE] = "vlan_remove",
+};
+
+/* events a ubus peer asked for through notify_events */
+struct ubus_event_filter {
+	struct dl_list list;
+	uint32_t peer;
+	uint32_t mask;
+};
+
+/*
+ * Management frame events are built once and reused as long as the input
+ * does not change, a broadcast probe request is reported on every BSS.
+ */
+struct ubus_event_key {
+	enum hostapd_ubus_event_type type;
+	int ssi_signal;
+	int freq;
+	u8 addr[ETH_ALEN];
+	u8 target[ETH_ALEN];
+	u8 has_target;
+	u8 has_ht;
+	u8 has_vht;
+	struct ieee80211_ht_capabilities ht;
+	struct ieee80211_vht_capabilities vht;
+};
+
+static struct blob_buf event_buf;
+static struct ubus_event_key event_key;
+static bool event_key_valid;
+
 static void ubus_receive(int sock, void *eloop_ctx, void *sock_ctx)
 {
 	struct ubus_context *ctx = eloop_ctx;
@@ -197,6 +292,286 @@ hostapd_bss_ban_client(struct hostapd_data *hapd, u8 *addr, int time)
 	eloop_register_timeout(0, time * 1000, hostapd_bss_del_ban, ban, hapd);
 }
 
+static void
+hostapd_bss_del_verdict(void *eloop_data, void *user_ctx)
+{
+	struct ubus_verdict *v = eloop_data;
+	struct hostapd_data *hapd = user_ctx;
+
+	avl_delete(&hapd->ubus.verdicts, &v->avl);
+	free(v);
+}
+
+static struct ubus_verdict *
+hostapd_bss_get_verdict(struct hostapd_data *hapd, const u8 *addr, bool create)
+{
+	struct ubus_verdict *v;
+
+	v = avl_find_element(&hapd->ubus.verdicts, addr, v, avl);
+	if (v || !create)
+		return v;
+
+	v = os_zalloc(sizeof(*v));
+	if (!v)
+		return NULL;
+
+	memcpy(v->addr, addr, sizeof(v->addr));
+	v->avl.key = v->addr;
+	avl_insert(&hapd->ubus.verdicts, &v->avl);
+
+	return v;
+}
+
+static void
+hostapd_bss_store_verdict(struct hostapd_data *hapd, const u8 *addr,
+			  enum hostapd_ubus_event_type type, int resp)
+{
+	unsigned int ttl = hapd->ubus.verdict_ttl;
+	struct ubus_verdict *v;
+	struct os_reltime *expire;
+
+	if (!ttl)
+		return;
+
+	v = hostapd_bss_get_verdict(hapd, addr, true);
+	if (!v)
+		return;
+
+	expire = &v->expire[type];
+	os_get_reltime(expire);
+	expire->sec += ttl / 1000;
+	expire->usec += (ttl % 1000) * 1000;
+	if (expire->usec >= 1000000) {
+		expire->sec++;
+		expire->usec -= 1000000;
+	}
+
+	v->resp[type] = resp;
+	v->valid |= BIT(type);
+
+	/* the entry goes away once the most recent verdict expired */
+	eloop_cancel_timeout(hostapd_bss_del_verdict, v, hapd);
+	eloop_register_timeout(0, ttl * 1000, hostapd_bss_del_verdict, v, hapd);
+}
+
+static bool
+hostapd_bss_cached_verdict(struct hostapd_data *hapd, const u8 *addr,
+			   enum hostapd_ubus_event_type type, int *resp)
+{
+	struct ubus_verdict *v;
+	struct os_reltime now;
+
+	v = hostapd_bss_get_verdict(hapd, addr, false);
+	if (!v || !(v->valid & BIT(type)))
+		return false;
+
+	os_get_reltime(&now);
+	if (os_reltime_before(&v->expire[type], &now))
+		return false;
+
+	*resp = v->resp[type];
+	return true;
+}
+
+static void
+hostapd_ubus_verdict_account(unsigned long long *sum, unsigned long *max,
+			     const struct os_reltime *start)
+{
+	struct os_reltime now, diff;
+	unsigned long usec;
+
+	os_get_reltime(&now);
+	os_reltime_sub(&now, start, &diff);
+	usec = diff.sec * 1000000 + diff.usec;
+
+	*sum += usec;
+	if (usec > *max)
+		*max = usec;
+}
+
+static void hostapd_ubus_verdict_timeout(void *eloop_data, void *user_ctx);
+
+static void
+hostapd_ubus_verdict_req_free(struct ubus_verdict_req *vreq)
+{
+	struct hostapd_data *hapd = vreq->hapd;
+	struct ubus_verdict *v;
+
+	eloop_cancel_timeout(hostapd_ubus_verdict_timeout, vreq, NULL);
+	dl_list_del(&vreq->list);
+
+	v = hostapd_bss_get_verdict(hapd, vreq->addr, false);
+	if (v) {
+		v->pending &= ~BIT(vreq->type);
+		if (!v->valid && !v->pending)
+			hostapd_bss_del_verdict(v, hapd);
+	}
+
+	free(vreq);
+}
+
+static void
+hostapd_ubus_verdict_timeout(void *eloop_data, void *user_ctx)
+{
+	struct ubus_verdict_req *vreq = eloop_data;
+
+	vreq->hapd->ubus.verdict_stats.timeouts++;
+	ubus_abort_request(ctx, &vreq->nreq.req);
+	hostapd_ubus_verdict_req_free(vreq);
+}
+
+static void
+ubus_verdict_status_cb(struct ubus_notify_request *req, int idx, int ret)
+{
+	struct ubus_verdict_req *vreq = container_of(req, struct ubus_verdict_req, nreq);
+
+	vreq->resp = ret;
+}
+
+static void
+ubus_verdict_complete_cb(struct ubus_notify_request *req, int idx, int ret)
+{
+	struct ubus_verdict_req *vreq = container_of(req, struct ubus_verdict_req, nreq);
+	struct hostapd_data *hapd = vreq->hapd;
+	struct hostapd_ubus_verdict_stats *stats = &hapd->ubus.verdict_stats;
+
+	stats->replies++;
+	hostapd_ubus_verdict_account(&stats->latency_sum, &stats->latency_max,
+				     &vreq->sent);
+
+	hostapd_bss_store_verdict(hapd, vreq->addr, vreq->type, vreq->resp);
+	hostapd_ubus_verdict_req_free(vreq);
+}
+
+/* Sends the event and collects the verdict in the background */
+static void
+hostapd_ubus_verdict_query(struct hostapd_data *hapd, const u8 *addr,
+			   enum hostapd_ubus_event_type type, const char *name,
+			   struct blob_attr *msg)
+{
+	struct ubus_verdict_req *vreq;
+	struct ubus_verdict *v;
+
+	v = hostapd_bss_get_verdict(hapd, addr, true);
+	if (!v)
+		return;
+
+	vreq = os_zalloc(sizeof(*vreq));
+	if (!vreq)
+		goto out;
+
+	if (ubus_notify_async(ctx, &hapd->ubus.obj, name, msg, &vreq->nreq)) {
+		free(vreq);
+		goto out;
+	}
+
+	vreq->nreq.status_cb = ubus_verdict_status_cb;
+	vreq->nreq.complete_cb = ubus_verdict_complete_cb;
+	vreq->hapd = hapd;
+	vreq->type = type;
+	memcpy(vreq->addr, addr, sizeof(vreq->addr));
+	os_get_reltime(&vreq->sent);
+	dl_list_add(&hapd->ubus.verdict_reqs, &vreq->list);
+	v->pending |= BIT(type);
+
+	ubus_complete_request_async(ctx, &vreq->nreq.req);
+	eloop_register_timeout(0, HOSTAPD_UBUS_VERDICT_TIMEOUT * 1000,
+			       hostapd_ubus_verdict_timeout, vreq, NULL);
+
+	hapd->ubus.verdict_stats.queries++;
+	return;
+
+out:
+	if (!v->valid && !v->pending)
+		hostapd_bss_del_verdict(v, hapd);
+}
+
+static void
+hostapd_bss_flush_verdicts(struct hostapd_data *hapd)
+{
+	struct ubus_verdict_req *vreq, *tmp;
+	struct ubus_verdict *v, *vtmp;
+
+	dl_list_for_each_safe(vreq, tmp, &hapd->ubus.verdict_reqs,
+			      struct ubus_verdict_req, list) {
+		ubus_abort_request(ctx, &vreq->nreq.req);
+		hostapd_ubus_verdict_req_free(vreq);
+	}
+
+	avl_remove_all_elements(&hapd->ubus.verdicts, v, avl, vtmp) {
+		eloop_cancel_timeout(hostapd_bss_del_verdict, v, hapd);
+		free(v);
+	}
+}
+
+static int
+hostapd_ubus_event_lookup(const char *name)
+{
+	int i;
+
+	for (i = 0; i < __HOSTAPD_UBUS_EV_MAX; i++)
+		if (!strcmp(name, event_names[i]))
+			return i;
+
+	return -1;
+}
+
+/* Checks whether any subscriber asked for the event before it gets built */
+static bool
+hostapd_ubus_event_wanted(struct hostapd_data *hapd, int ev)
+{
+	if (!hapd->ubus.obj.has_subscribers)
+		return false;
+
+	if (ev >= 0 && !(hapd->ubus.event_mask & BIT(ev))) {
+		hapd->ubus.events_suppressed++;
+		return false;
+	}
+
+	hapd->ubus.events_sent++;
+	return true;
+}
+
+static void
+hostapd_bss_update_event_mask(struct hostapd_data *hapd)
+{
+	struct ubus_event_filter *f;
+
+	/* without any filter set, everything is sent */
+	if (dl_list_empty(&hapd->ubus.event_filters)) {
+		hapd->ubus.event_mask = HOSTAPD_UBUS_EV_ALL;
+		return;
+	}
+
+	hapd->ubus.event_mask = 0;
+	dl_list_for_each(f, &hapd->ubus.event_filters, struct ubus_event_filter, list)
+		hapd->ubus.event_mask |= f->mask;
+}
+
+static void
+hostapd_bss_flush_event_filters(struct hostapd_data *hapd)
+{
+	struct ubus_event_filter *f, *tmp;
+
+	dl_list_for_each_safe(f, tmp, &hapd->ubus.event_filters,
+			      struct ubus_event_filter, list) {
+		dl_list_del(&f->list);
+		free(f);
+	}
+
+	hostapd_bss_update_event_mask(hapd);
+}
+
+static void
+hostapd_bss_subscribe_cb(struct ubus_context *ctx, struct ubus_object *obj)
+{
+	struct hostapd_data *hapd = get_hapd_from_object(obj);
+
+	/* with the last subscriber gone, nobody is left to own a filter */
+	if (!obj->has_subscribers)
+		hostapd_bss_flush_event_filters(hapd);
+}
+
 static int
 hostapd_bss_reload(struct ubus_context *ctx, struct ubus_object *obj,
 		   struct ubus_request_data *req, const char *method,
@@ -278,16 +653,143 @@ hostapd_parse_capab_blobmsg(struct sta_info *sta)
 	blobmsg_close_table(&b, v);
 }
 
+enum {
+	CLIENT_FIELD_BYTES = BIT(0),
+	CLIENT_FIELD_AIRTIME = BIT(1),
+	CLIENT_FIELD_PACKETS = BIT(2),
+	CLIENT_FIELD_RATE = BIT(3),
+	CLIENT_FIELD_SIGNAL = BIT(4),
+	CLIENT_FIELD_RRM = BIT(5),
+	CLIENT_FIELD_EXT_CAPA = BIT(6),
+	CLIENT_FIELD_SIGNATURE = BIT(7),
+	CLIENT_FIELD_CAPA = BIT(8),
+};
+
+#define CLIENT_FIELDS_DRIVER \
+	(CLIENT_FIELD_BYTES | CLIENT_FIELD_AIRTIME | CLIENT_FIELD_PACKETS | \
+	 CLIENT_FIELD_RATE | CLIENT_FIELD_SIGNAL)
+
+static const struct {
+	const char *name;
+	uint32_t flag;
+} client_fields[] = {
+	{ "bytes", CLIENT_FIELD_BYTES },
+	{ "airtime", CLIENT_FIELD_AIRTIME },
+	{ "packets", CLIENT_FIELD_PACKETS },
+	{ "rate", CLIENT_FIELD_RATE },
+	{ "signal", CLIENT_FIELD_SIGNAL },
+	{ "rrm", CLIENT_FIELD_RRM },
+	{ "extended_capabilities", CLIENT_FIELD_EXT_CAPA },
+	{ "signature", CLIENT_FIELD_SIGNATURE },
+	{ "capabilities", CLIENT_FIELD_CAPA },
+};
+
+enum {
+	CLIENTS_FIELDS,
+	__CLIENTS_MAX
+};
+
+static const struct blobmsg_policy clients_policy[__CLIENTS_MAX] = {
+	[CLIENTS_FIELDS] = { "fields", BLOBMSG_TYPE_ARRAY },
+};
+
+struct sta_dump_entry {
+	u8 addr[ETH_ALEN]; /* must be first, used as search key */
+	struct hostap_sta_driver_data data;
+};
+
+struct sta_dump {
+	struct sta_dump_entry *entries;
+	size_t count;
+	size_t size;
+};
+
+static void
+hostapd_sta_dump_cb(void *ctx, const u8 *addr, struct hostap_sta_driver_data *data)
+{
+	struct sta_dump *dump = ctx;
+	struct sta_dump_entry *e;
+
+	if (dump->count == dump->size) {
+		size_t size = dump->size ? dump->size * 2 : 16;
+
+		e = os_realloc_array(dump->entries, size, sizeof(*e));
+		if (!e)
+			return;
+
+		dump->entries = e;
+		dump->size = size;
+	}
+
+	e = &dump->entries[dump->count++];
+	memcpy(e->addr, addr, ETH_ALEN);
+	memcpy(&e->data, data, sizeof(*data));
+}
+
+static int
+hostapd_sta_dump_cmp(const void *k1, const void *k2)
+{
+	return memcmp(k1, k2, ETH_ALEN);
+}
+
+/* Fetches the driver data of all stations with a single request */
+static bool
+hostapd_sta_dump(struct hostapd_data *hapd, struct sta_dump *dump)
+{
+	memset(dump, 0, sizeof(*dump));
+
+	if (!hapd->driver || !hapd->driver->read_sta_data_all)
+		return false;
+
+	if (hapd->num_sta) {
+		dump->entries = os_calloc(hapd->num_sta, sizeof(*dump->entries));
+		if (!dump->entries)
+			return false;
+		dump->size = hapd->num_sta;
+	}
+
+	if (hapd->driver->read_sta_data_all(hapd->drv_priv, hostapd_sta_dump_cb,
+					    dump) < 0) {
+		os_free(dump->entries);
+		dump->entries = NULL;
+		return false;
+	}
+
+	qsort(dump->entries, dump->count, sizeof(*dump->entries),
+	      hostapd_sta_dump_cmp);
+
+	return true;
+}
+
+static struct hostap_sta_driver_data *
+hostapd_sta_dump_get(struct sta_dump *dump, const u8 *addr)
+{
+	struct sta_dump_entry *e;
+
+	if (!dump->count)
+		return NULL;
+
+	e = bsearch(addr, dump->entries, dump->count, sizeof(*dump->entries),
+		    hostapd_sta_dump_cmp);
+
+	return e ? &e->data : NULL;
+}
+
 static int
 hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 			struct ubus_request_data *req, const char *method,
 			struct blob_attr *msg)
 {
 	struct hostapd_data *hapd = container_of(obj, struct hostapd_data, ubus.obj);
-	struct hostap_sta_driver_data sta_driver_data;
+	struct hostap_sta_driver_data sta_driver_data, *sta_data;
+	struct blob_attr *tb[__CLIENTS_MAX], *cur;
+	struct sta_dump dump;
+	bool dumped = false;
+	uint32_t fields = ~0;
 	struct sta_info *sta;
 	void *list, *c;
 	char mac_buf[20];
+	int rem;
 	static const struct {
 		const char *name;
 		uint32_t flag;
@@ -305,6 +807,30 @@ hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 		{ "mfp", WLAN_STA_MFP },
 	};
 
+	blobmsg_parse(clients_policy, __CLIENTS_MAX, tb, blob_data(msg), blob_len(msg));
+
+	if (tb[CLIENTS_FIELDS]) {
+		fields = 0;
+		blobmsg_for_each_attr(cur, tb[CLIENTS_FIELDS], rem) {
+			int i;
+
+			if (blobmsg_type(cur) != BLOBMSG_TYPE_STRING)
+				return UBUS_STATUS_INVALID_ARGUMENT;
+
+			for (i = 0; i < ARRAY_SIZE(client_fields); i++)
+				if (!strcmp(blobmsg_get_string(cur), client_fields[i].name))
+					break;
+
+			if (i == ARRAY_SIZE(client_fields))
+				return UBUS_STATUS_INVALID_ARGUMENT;
+
+			fields |= client_fields[i].flag;
+		}
+	}
+
+	if (fields & CLIENT_FIELDS_DRIVER)
+		dumped = hostapd_sta_dump(hapd, &dump);
+
 	blob_buf_init(&b, 0);
 	blobmsg_add_u32(&b, "freq", hapd->iface->freq);
 	list = blobmsg_open_table(&b, "clients");
@@ -322,56 +848,83 @@ hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 		blobmsg_add_u8(&b, "mbo", !!(sta->cell_capa));
 #endif
 
-		r = blobmsg_open_array(&b, "rrm");
-		for (i = 0; i < ARRAY_SIZE(sta->rrm_enabled_capa); i++)
-			blobmsg_add_u32(&b, "", sta->rrm_enabled_capa[i]);
-		blobmsg_close_array(&b, r);
+		if (fields & CLIENT_FIELD_RRM) {
+			r = blobmsg_open_array(&b, "rrm");
+			for (i = 0; i < ARRAY_SIZE(sta->rrm_enabled_capa); i++)
+				blobmsg_add_u32(&b, "", sta->rrm_enabled_capa[i]);
+			blobmsg_close_array(&b, r);
+		}
 
-		r = blobmsg_open_array(&b, "extended_capabilities");
-		/* Check if client advertises extended capabilities */
-		if (sta->ext_capability && sta->ext_capability[0] > 0) {
-			for (i = 0; i < sta->ext_capability[0]; i++) {
-				blobmsg_add_u32(&b, "", sta->ext_capability[1 + i]);
+		if (fields & CLIENT_FIELD_EXT_CAPA) {
+			r = blobmsg_open_array(&b, "extended_capabilities");
+			/* Check if client advertises extended capabilities */
+			if (sta->ext_capability && sta->ext_capability[0] > 0) {
+				for (i = 0; i < sta->ext_capability[0]; i++) {
+					blobmsg_add_u32(&b, "", sta->ext_capability[1 + i]);
+				}
 			}
+			blobmsg_close_array(&b, r);
 		}
-		blobmsg_close_array(&b, r);
 
 		blobmsg_add_u32(&b, "aid", sta->aid);
 #ifdef CONFIG_TAXONOMY
-		r = blobmsg_alloc_string_buffer(&b, "signature", 1024);
-		if (retrieve_sta_taxonomy(hapd, sta, r, 1024) > 0)
-			blobmsg_add_string_buffer(&b);
+		if (fields & CLIENT_FIELD_SIGNATURE) {
+			r = blobmsg_alloc_string_buffer(&b, "signature", 1024);
+			if (retrieve_sta_taxonomy(hapd, sta, r, 1024) > 0)
+				blobmsg_add_string_buffer(&b);
+		}
 #endif
 
 		/* Driver information */
-		if (hostapd_drv_read_sta_data(hapd, &sta_driver_data, sta->addr) >= 0) {
-			r = blobmsg_open_table(&b, "bytes");
-			blobmsg_add_u64(&b, "rx", sta_driver_data.rx_bytes);
-			blobmsg_add_u64(&b, "tx", sta_driver_data.tx_bytes);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "airtime");
-			blobmsg_add_u64(&b, "rx", sta_driver_data.rx_airtime);
-			blobmsg_add_u64(&b, "tx", sta_driver_data.tx_airtime);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "packets");
-			blobmsg_add_u32(&b, "rx", sta_driver_data.rx_packets);
-			blobmsg_add_u32(&b, "tx", sta_driver_data.tx_packets);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "rate");
-			/* Rate in kbits */
-			blobmsg_add_u32(&b, "rx", sta_driver_data.current_rx_rate * 100);
-			blobmsg_add_u32(&b, "tx", sta_driver_data.current_tx_rate * 100);
-			blobmsg_close_table(&b, r);
-			blobmsg_add_u32(&b, "signal", sta_driver_data.signal);
+		sta_data = NULL;
+		if (dumped)
+			sta_data = hostapd_sta_dump_get(&dump, sta->addr);
+		/* stations moved to an AP_VLAN netdev are not in the BSS dump */
+		if (!sta_data && (fields & CLIENT_FIELDS_DRIVER) &&
+		    hostapd_drv_read_sta_data(hapd, &sta_driver_data, sta->addr) >= 0)
+			sta_data = &sta_driver_data;
+
+		if (sta_data) {
+			if (fields & CLIENT_FIELD_BYTES) {
+				r = blobmsg_open_table(&b, "bytes");
+				blobmsg_add_u64(&b, "rx", sta_data->rx_bytes);
+				blobmsg_add_u64(&b, "tx", sta_data->tx_bytes);
+				blobmsg_close_table(&b, r);
+			}
+			if (fields & CLIENT_FIELD_AIRTIME) {
+				r = blobmsg_open_table(&b, "airtime");
+				blobmsg_add_u64(&b, "rx", sta_data->rx_airtime);
+				blobmsg_add_u64(&b, "tx", sta_data->tx_airtime);
+				blobmsg_close_table(&b, r);
+			}
+			if (fields & CLIENT_FIELD_PACKETS) {
+				r = blobmsg_open_table(&b, "packets");
+				blobmsg_add_u32(&b, "rx", sta_data->rx_packets);
+				blobmsg_add_u32(&b, "tx", sta_data->tx_packets);
+				blobmsg_close_table(&b, r);
+			}
+			if (fields & CLIENT_FIELD_RATE) {
+				r = blobmsg_open_table(&b, "rate");
+				/* Rate in kbits */
+				blobmsg_add_u32(&b, "rx", sta_data->current_rx_rate * 100);
+				blobmsg_add_u32(&b, "tx", sta_data->current_tx_rate * 100);
+				blobmsg_close_table(&b, r);
+			}
+			if (fields & CLIENT_FIELD_SIGNAL)
+				blobmsg_add_u32(&b, "signal", sta_data->signal);
 		}
 
-		hostapd_parse_capab_blobmsg(sta);
+		if (fields & CLIENT_FIELD_CAPA)
+			hostapd_parse_capab_blobmsg(sta);
 
 		blobmsg_close_table(&b, c);
 	}
 	blobmsg_close_array(&b, list);
 	ubus_send_reply(ctx, req, b.head);
 
+	if (dumped)
+		os_free(dump.entries);
+
 	return 0;
 }
 
@@ -494,11 +1047,13 @@ hostapd_bss_get_status(struct ubus_context *ctx, struct ubus_object *obj,
 
 enum {
 	NOTIFY_RESPONSE,
+	NOTIFY_VERDICT_TTL,
 	__NOTIFY_MAX
 };
 
 static const struct blobmsg_policy notify_policy[__NOTIFY_MAX] = {
 	[NOTIFY_RESPONSE] = { "notify_response", BLOBMSG_TYPE_INT32 },
+	[NOTIFY_VERDICT_TTL] = { "verdict_ttl", BLOBMSG_TYPE_INT32 },
 };
 
 static int
@@ -520,6 +1075,125 @@ hostapd_notify_response(struct ubus_context *ctx, struct ubus_object *obj,
 
 	hapd->ubus.notify_response = blobmsg_get_u32(tb[NOTIFY_RESPONSE]);
 
+	/* cached verdicts may no longer reflect the subscribers' policy */
+	hostapd_bss_flush_verdicts(hapd);
+	if (tb[NOTIFY_VERDICT_TTL])
+		hapd->ubus.verdict_ttl = blobmsg_get_u32(tb[NOTIFY_VERDICT_TTL]);
+
+	return UBUS_STATUS_OK;
+}
+
+static int
+hostapd_notify_stats(struct ubus_context *ctx, struct ubus_object *obj,
+		     struct ubus_request_data *req, const char *method,
+		     struct blob_attr *msg)
+{
+	struct hostapd_data *hapd = get_hapd_from_object(obj);
+	struct hostapd_ubus_verdict_stats *stats = &hapd->ubus.verdict_stats;
+	void *c;
+	int i;
+
+	blob_buf_init(&b, 0);
+	blobmsg_add_u32(&b, "notify_response", hapd->ubus.notify_response);
+	blobmsg_add_u32(&b, "verdict_ttl", hapd->ubus.verdict_ttl);
+	blobmsg_add_u32(&b, "cached", hapd->ubus.verdicts.count);
+	blobmsg_add_u32(&b, "pending", dl_list_len(&hapd->ubus.verdict_reqs));
+	blobmsg_add_u64(&b, "hits", stats->hits);
+	blobmsg_add_u64(&b, "misses", stats->misses);
+	blobmsg_add_u64(&b, "queries", stats->queries);
+	blobmsg_add_u64(&b, "replies", stats->replies);
+	blobmsg_add_u64(&b, "timeouts", stats->timeouts);
+	if (stats->replies) {
+		blobmsg_add_u64(&b, "latency_avg", stats->latency_sum / stats->replies);
+		blobmsg_add_u64(&b, "latency_max", stats->latency_max);
+	}
+	/* time the event loop spent waiting for auth/assoc verdicts */
+	blobmsg_add_u64(&b, "sync_waits", stats->sync_waits);
+	if (stats->sync_waits) {
+		blobmsg_add_u64(&b, "blocked_avg", stats->blocked_sum / stats->sync_waits);
+		blobmsg_add_u64(&b, "blocked_max", stats->blocked_max);
+	}
+
+	blobmsg_add_u64(&b, "events_sent", hapd->ubus.events_sent);
+	blobmsg_add_u64(&b, "events_suppressed", hapd->ubus.events_suppressed);
+	c = blobmsg_open_array(&b, "events");
+	for (i = 0; i < __HOSTAPD_UBUS_EV_MAX; i++)
+		if (hapd->ubus.event_mask & BIT(i))
+			blobmsg_add_string(&b, NULL, event_names[i]);
+	blobmsg_close_array(&b, c);
+
+	ubus_send_reply(ctx, req, b.head);
+
+	return 0;
+}
+
+enum {
+	NOTIFY_EVENTS_EVENTS,
+	__NOTIFY_EVENTS_MAX
+};
+
+static const struct blobmsg_policy notify_events_policy[__NOTIFY_EVENTS_MAX] = {
+	[NOTIFY_EVENTS_EVENTS] = { "events", BLOBMSG_TYPE_ARRAY },
+};
+
+static int
+hostapd_notify_events(struct ubus_context *ctx, struct ubus_object *obj,
+		      struct ubus_request_data *req, const char *method,
+		      struct blob_attr *msg)
+{
+	struct blob_attr *tb[__NOTIFY_EVENTS_MAX];
+	struct hostapd_data *hapd = get_hapd_from_object(obj);
+	struct ubus_event_filter *f, *found = NULL;
+	struct blob_attr *cur;
+	uint32_t mask = 0;
+	int rem;
+
+	blobmsg_parse(notify_events_policy, __NOTIFY_EVENTS_MAX, tb,
+		      blob_data(msg), blob_len(msg));
+
+	if (tb[NOTIFY_EVENTS_EVENTS]) {
+		blobmsg_for_each_attr(cur, tb[NOTIFY_EVENTS_EVENTS], rem) {
+			int ev;
+
+			if (blobmsg_type(cur) != BLOBMSG_TYPE_STRING)
+				return UBUS_STATUS_INVALID_ARGUMENT;
+
+			ev = hostapd_ubus_event_lookup(blobmsg_get_string(cur));
+			if (ev < 0)
+				return UBUS_STATUS_INVALID_ARGUMENT;
+
+			mask |= BIT(ev);
+		}
+	}
+
+	/* filters are kept per calling ubus client */
+	dl_list_for_each(f, &hapd->ubus.event_filters, struct ubus_event_filter, list) {
+		if (f->peer == req->peer) {
+			found = f;
+			break;
+		}
+	}
+
+	/* without an event list the caller's filter is dropped */
+	if (!tb[NOTIFY_EVENTS_EVENTS]) {
+		if (found) {
+			dl_list_del(&found->list);
+			free(found);
+		}
+	} else {
+		if (!found) {
+			found = os_zalloc(sizeof(*found));
+			if (!found)
+				return UBUS_STATUS_UNKNOWN_ERROR;
+
+			found->peer = req->peer;
+			dl_list_add(&hapd->ubus.event_filters, &found->list);
+		}
+		found->mask = mask;
+	}
+
+	hostapd_bss_update_event_mask(hapd);
+
 	return UBUS_STATUS_OK;
 }
 
@@ -1438,7 +2112,7 @@ void hostapd_ubus_handle_link_measurement(struct hostapd_data *hapd, const u8 *d
 	if (end - pos < 8)
 		return;
 
-	if (!hapd->ubus.obj.has_subscribers)
+	if (!hostapd_ubus_event_wanted(hapd, HOSTAPD_UBUS_EV_LINK_MEASUREMENT))
 		return;
 
 	blob_buf_init(&b, 0);
@@ -1696,7 +2370,7 @@ hostapd_bss_update_airtime(struct ubus_context *ctx, struct ubus_object *obj,
 
 static const struct ubus_method bss_methods[] = {
 	UBUS_METHOD_NOARG("reload", hostapd_bss_reload),
-	UBUS_METHOD_NOARG("get_clients", hostapd_bss_get_clients),
+	UBUS_METHOD("get_clients", hostapd_bss_get_clients, clients_policy),
 	UBUS_METHOD_NOARG("get_status", hostapd_bss_get_status),
 	UBUS_METHOD("del_client", hostapd_bss_del_client, del_policy),
 #ifdef CONFIG_AIRTIME_POLICY
@@ -1715,6 +2389,8 @@ static const struct ubus_method bss_methods[] = {
 #endif
 	UBUS_METHOD("set_vendor_elements", hostapd_vendor_elements, ve_policy),
 	UBUS_METHOD("notify_response", hostapd_notify_response, notify_policy),
+	UBUS_METHOD_NOARG("notify_stats", hostapd_notify_stats),
+	UBUS_METHOD("notify_events", hostapd_notify_events, notify_events_policy),
 	UBUS_METHOD("bss_mgmt_enable", hostapd_bss_mgmt_enable, bss_mgmt_enable_policy),
 	UBUS_METHOD_NOARG("rrm_nr_get_own", hostapd_rrm_nr_get_own),
 	UBUS_METHOD_NOARG("rrm_nr_list", hostapd_rrm_nr_list),
@@ -1745,6 +2421,12 @@ void hostapd_ubus_add_bss(struct hostapd_data *hapd)
 		return;
 #endif
 
+	avl_init(&hapd->ubus.verdicts, avl_compare_macaddr, false, NULL);
+	dl_list_init(&hapd->ubus.verdict_reqs);
+	hapd->ubus.verdict_ttl = HOSTAPD_UBUS_VERDICT_TTL;
+	dl_list_init(&hapd->ubus.event_filters);
+	hapd->ubus.event_mask = HOSTAPD_UBUS_EV_ALL;
+
 	if (!hostapd_ubus_init())
 		return;
 
@@ -1756,6 +2438,7 @@ void hostapd_ubus_add_bss(struct hostapd_data *hapd)
 	obj->type = &bss_object_type;
 	obj->methods = bss_object_type.methods;
 	obj->n_methods = bss_object_type.n_methods;
+	obj->subscribe_cb = hostapd_bss_subscribe_cb;
 	ret = ubus_add_object(ctx, obj);
 	hostapd_ubus_ref_inc();
 
@@ -1772,6 +2455,15 @@ void hostapd_ubus_free_bss(struct hostapd_data *hapd)
 		return;
 #endif
 
+	/*
+	 * hostapd_free_hapd_data() also gets here for a BSS whose setup
+	 * failed before hostapd_ubus_add_bss() initialized the lists
+	 */
+	if (hapd->ubus.verdict_reqs.next)
+		hostapd_bss_flush_verdicts(hapd);
+	if (hapd->ubus.event_filters.next)
+		hostapd_bss_flush_event_filters(hapd);
+
 	if (!ctx)
 		return;
 
@@ -1787,13 +2479,13 @@ void hostapd_ubus_free_bss(struct hostapd_data *hapd)
 
 static void
 hostapd_ubus_vlan_action(struct hostapd_data *hapd, struct hostapd_vlan *vlan,
-			 const char *action)
+			 int ev)
 {
 	struct vlan_description *desc = &vlan->vlan_desc;
 	void *c;
 	int i;
 
-	if (!hapd->ubus.obj.has_subscribers)
+	if (!hostapd_ubus_event_wanted(hapd, ev))
 		return;
 
 	blob_buf_init(&b, 0);
@@ -1809,17 +2501,17 @@ hostapd_ubus_vlan_action(struct hostapd_data *hapd, struct hostapd_vlan *vlan,
 		blobmsg_close_array(&b, c);
 	}
 
-	ubus_notify(ctx, &hapd->ubus.obj, action, b.head, -1);
+	ubus_notify(ctx, &hapd->ubus.obj, event_names[ev], b.head, -1);
 }
 
 void hostapd_ubus_add_vlan(struct hostapd_data *hapd, struct hostapd_vlan *vlan)
 {
-	hostapd_ubus_vlan_action(hapd, vlan, "vlan_add");
+	hostapd_ubus_vlan_action(hapd, vlan, HOSTAPD_UBUS_EV_VLAN_ADD);
 }
 
 void hostapd_ubus_remove_vlan(struct hostapd_data *hapd, struct hostapd_vlan *vlan)
 {
-	hostapd_ubus_vlan_action(hapd, vlan, "vlan_remove");
+	hostapd_ubus_vlan_action(hapd, vlan, HOSTAPD_UBUS_EV_VLAN_REMOVE);
 }
 
 static const struct ubus_method daemon_methods[] = {
@@ -1876,17 +2568,93 @@ ubus_event_cb(struct ubus_notify_request *req, int idx, int ret)
 	ureq->resp = ret;
 }
 
+/* Fills event_buf, unless it still holds the same event */
+static void
+hostapd_ubus_build_event(struct hostapd_data *hapd, struct hostapd_ubus_request *req,
+			 const u8 *addr)
+{
+	const struct ieee802_11_elems *elems = req->elems;
+	struct ubus_event_key key;
+
+	os_memset(&key, 0, sizeof(key));
+	key.type = req->type;
+	key.ssi_signal = req->ssi_signal;
+	key.freq = hapd->iface->freq;
+	memcpy(key.addr, addr, ETH_ALEN);
+	if (req->mgmt_frame) {
+		key.has_target = 1;
+		memcpy(key.target, req->mgmt_frame->da, ETH_ALEN);
+	}
+	if (elems && elems->ht_capabilities) {
+		key.has_ht = 1;
+		memcpy(&key.ht, elems->ht_capabilities, sizeof(key.ht));
+	}
+	if (elems && elems->vht_capabilities) {
+		key.has_vht = 1;
+		memcpy(&key.vht, elems->vht_capabilities, sizeof(key.vht));
+	}
+
+	if (event_key_valid && !memcmp(&key, &event_key, sizeof(key)))
+		return;
+
+	memcpy(&event_key, &key, sizeof(key));
+	event_key_valid = true;
+
+	blob_buf_init(&event_buf, 0);
+	blobmsg_add_macaddr(&event_buf, "address", addr);
+	if (key.has_target)
+		blobmsg_add_macaddr(&event_buf, "target", key.target);
+	if (key.ssi_signal)
+		blobmsg_add_u32(&event_buf, "signal", key.ssi_signal);
+	blobmsg_add_u32(&event_buf, "freq", key.freq);
+
+	if (key.has_ht) {
+		struct ieee80211_ht_capabilities *ht_capabilities = &key.ht;
+		void *ht_cap, *ht_cap_mcs_set, *mcs_set;
+
+		ht_cap = blobmsg_open_table(&event_buf, "ht_capabilities");
+		blobmsg_add_u16(&event_buf, "ht_capabilities_info", ht_capabilities->ht_capabilities_info);
+		ht_cap_mcs_set = blobmsg_open_table(&event_buf, "supported_mcs_set");
+		blobmsg_add_u16(&event_buf, "a_mpdu_params", ht_capabilities->a_mpdu_params);
+		blobmsg_add_u16(&event_buf, "ht_extended_capabilities", ht_capabilities->ht_extended_capabilities);
+		blobmsg_add_u32(&event_buf, "tx_bf_capability_info", ht_capabilities->tx_bf_capability_info);
+		blobmsg_add_u16(&event_buf, "asel_capabilities", ht_capabilities->asel_capabilities);
+		mcs_set = blobmsg_open_array(&event_buf, "supported_mcs_set");
+		for (int i = 0; i < 16; i++) {
+			blobmsg_add_u16(&event_buf, NULL, (u16) ht_capabilities->supported_mcs_set[i]);
+		}
+		blobmsg_close_array(&event_buf, mcs_set);
+		blobmsg_close_table(&event_buf, ht_cap_mcs_set);
+		blobmsg_close_table(&event_buf, ht_cap);
+	}
+	if (key.has_vht) {
+		struct ieee80211_vht_capabilities *vht_capabilities = &key.vht;
+		void *vht_cap, *vht_cap_mcs_set;
+
+		vht_cap = blobmsg_open_table(&event_buf, "vht_capabilities");
+		blobmsg_add_u32(&event_buf, "vht_capabilities_info", vht_capabilities->vht_capabilities_info);
+		vht_cap_mcs_set = blobmsg_open_table(&event_buf, "vht_supported_mcs_set");
+		blobmsg_add_u16(&event_buf, "rx_map", vht_capabilities->vht_supported_mcs_set.rx_map);
+		blobmsg_add_u16(&event_buf, "rx_highest", vht_capabilities->vht_supported_mcs_set.rx_highest);
+		blobmsg_add_u16(&event_buf, "tx_map", vht_capabilities->vht_supported_mcs_set.tx_map);
+		blobmsg_add_u16(&event_buf, "tx_highest", vht_capabilities->vht_supported_mcs_set.tx_highest);
+		blobmsg_close_table(&event_buf, vht_cap_mcs_set);
+		blobmsg_close_table(&event_buf, vht_cap);
+	}
+}
+
 int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_request *req)
 {
 	struct ubus_banned_client *ban;
-	const char *types[HOSTAPD_UBUS_TYPE_MAX] = {
-		[HOSTAPD_UBUS_PROBE_REQ] = "probe",
-		[HOSTAPD_UBUS_AUTH_REQ] = "auth",
-		[HOSTAPD_UBUS_ASSOC_REQ] = "assoc",
-	};
-	const char *type = "mgmt";
+	const char *type;
 	struct ubus_event_req ureq = {};
+	struct hostapd_ubus_verdict_stats *stats;
+	struct ubus_verdict *v;
+	struct os_reltime start;
 	const u8 *addr;
+	bool cache;
+	int ev = HOSTAPD_UBUS_EV_MGMT;
+	int resp, ret;
 
 	if (req->mgmt_frame)
 		addr = req->mgmt_frame->sa;
@@ -1897,71 +2665,61 @@ int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_req
 	if (ban)
 		return WLAN_STATUS_AP_UNABLE_TO_HANDLE_NEW_STA;
 
-	if (!hapd->ubus.obj.has_subscribers)
+	if (req->type < HOSTAPD_UBUS_TYPE_MAX)
+		ev = req->type;
+	type = event_names[ev];
+
+	/* nobody would see the event or answer it */
+	if (!hostapd_ubus_event_wanted(hapd, ev))
 		return WLAN_STATUS_SUCCESS;
 
-	if (req->type < ARRAY_SIZE(types))
-		type = types[req->type];
+	hostapd_ubus_build_event(hapd, req, addr);
 
-	blob_buf_init(&b, 0);
-	blobmsg_add_macaddr(&b, "address", addr);
-	if (req->mgmt_frame)
-		blobmsg_add_macaddr(&b, "target", req->mgmt_frame->da);
-	if (req->ssi_signal)
-		blobmsg_add_u32(&b, "signal", req->ssi_signal);
-	blobmsg_add_u32(&b, "freq", hapd->iface->freq);
+	if (!hapd->ubus.notify_response) {
+		ubus_notify(ctx, &hapd->ubus.obj, type, event_buf.head, -1);
+		return WLAN_STATUS_SUCCESS;
+	}
 
-	if (req->elems) {
-		if(req->elems->ht_capabilities)
-		{
-			struct ieee80211_ht_capabilities *ht_capabilities;
-			void *ht_cap, *ht_cap_mcs_set, *mcs_set;
-
-
-			ht_capabilities = (struct ieee80211_ht_capabilities*) req->elems->ht_capabilities;
-			ht_cap = blobmsg_open_table(&b, "ht_capabilities");
-			blobmsg_add_u16(&b, "ht_capabilities_info", ht_capabilities->ht_capabilities_info);
-			ht_cap_mcs_set = blobmsg_open_table(&b, "supported_mcs_set");
-			blobmsg_add_u16(&b, "a_mpdu_params", ht_capabilities->a_mpdu_params);
-			blobmsg_add_u16(&b, "ht_extended_capabilities", ht_capabilities->ht_extended_capabilities);
-			blobmsg_add_u32(&b, "tx_bf_capability_info", ht_capabilities->tx_bf_capability_info);
-			blobmsg_add_u16(&b, "asel_capabilities", ht_capabilities->asel_capabilities);
-			mcs_set = blobmsg_open_array(&b, "supported_mcs_set");
-			for (int i = 0; i < 16; i++) {
-				blobmsg_add_u16(&b, NULL, (u16) ht_capabilities->supported_mcs_set[i]);
-			}
-			blobmsg_close_array(&b, mcs_set);
-			blobmsg_close_table(&b, ht_cap_mcs_set);
-			blobmsg_close_table(&b, ht_cap);
-		}
-		if(req->elems->vht_capabilities)
-		{
-			struct ieee80211_vht_capabilities *vht_capabilities;
-			void *vht_cap, *vht_cap_mcs_set;
-
-			vht_capabilities = (struct ieee80211_vht_capabilities*) req->elems->vht_capabilities;
-			vht_cap = blobmsg_open_table(&b, "vht_capabilities");
-			blobmsg_add_u32(&b, "vht_capabilities_info", vht_capabilities->vht_capabilities_info);
-			vht_cap_mcs_set = blobmsg_open_table(&b, "vht_supported_mcs_set");
-			blobmsg_add_u16(&b, "rx_map", vht_capabilities->vht_supported_mcs_set.rx_map);
-			blobmsg_add_u16(&b, "rx_highest", vht_capabilities->vht_supported_mcs_set.rx_highest);
-			blobmsg_add_u16(&b, "tx_map", vht_capabilities->vht_supported_mcs_set.tx_map);
-			blobmsg_add_u16(&b, "tx_highest", vht_capabilities->vht_supported_mcs_set.tx_highest);
-			blobmsg_close_table(&b, vht_cap_mcs_set);
-			blobmsg_close_table(&b, vht_cap);
-		}
+	stats = &hapd->ubus.verdict_stats;
+	cache = req->type < HOSTAPD_UBUS_TYPE_MAX;
+
+	if (cache && hostapd_bss_cached_verdict(hapd, addr, req->type, &resp)) {
+		/* subscribers still see the event, but don't need to answer it */
+		stats->hits++;
+		ubus_notify(ctx, &hapd->ubus.obj, type, event_buf.head, -1);
+		return resp;
 	}
 
-	if (!hapd->ubus.notify_response) {
-		ubus_notify(ctx, &hapd->ubus.obj, type, b.head, -1);
+	stats->misses++;
+
+	/*
+	 * Probe requests are answered right away, the verdict applies to the
+	 * station's following probes once it arrives.
+	 */
+	if (req->type == HOSTAPD_UBUS_PROBE_REQ) {
+		v = hostapd_bss_get_verdict(hapd, addr, false);
+		if (v && (v->pending & BIT(req->type)))
+			ubus_notify(ctx, &hapd->ubus.obj, type, event_buf.head, -1);
+		else
+			hostapd_ubus_verdict_query(hapd, addr, req->type, type,
+						   event_buf.head);
 		return WLAN_STATUS_SUCCESS;
 	}
 
-	if (ubus_notify_async(ctx, &hapd->ubus.obj, type, b.head, &ureq.nreq))
+	if (ubus_notify_async(ctx, &hapd->ubus.obj, type, event_buf.head, &ureq.nreq))
 		return WLAN_STATUS_SUCCESS;
 
 	ureq.nreq.status_cb = ubus_event_cb;
-	ubus_complete_request(ctx, &ureq.nreq.req, 100);
+	os_get_reltime(&start);
+	ret = ubus_complete_request(ctx, &ureq.nreq.req, HOSTAPD_UBUS_VERDICT_TIMEOUT);
+
+	stats->sync_waits++;
+	hostapd_ubus_verdict_account(&stats->blocked_sum, &stats->blocked_max, &start);
+
+	if (ret == UBUS_STATUS_TIMEOUT)
+		stats->timeouts++;
+	else if (cache)
+		hostapd_bss_store_verdict(hapd, addr, req->type, ureq.resp);
 
 	if (ureq.resp)
 		return ureq.resp;
@@ -1971,10 +2729,10 @@ int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_req
 
 void hostapd_ubus_notify(struct hostapd_data *hapd, const char *type, const u8 *addr)
 {
-	if (!hapd->ubus.obj.has_subscribers)
+	if (!addr)
 		return;
 
-	if (!addr)
+	if (!hostapd_ubus_event_wanted(hapd, hostapd_ubus_event_lookup(type)))
 		return;
 
 	blob_buf_init(&b, 0);
@@ -1986,7 +2744,7 @@ void hostapd_ubus_notify(struct hostapd_data *hapd, const char *type, const u8 *
 void hostapd_ubus_notify_authorized(struct hostapd_data *hapd, struct sta_info *sta,
 				    const char *auth_alg)
 {
-	if (!hapd->ubus.obj.has_subscribers)
+	if (!hostapd_ubus_event_wanted(hapd, HOSTAPD_UBUS_EV_STA_AUTHORIZED))
 		return;
 
 	blob_buf_init(&b, 0);
@@ -2001,10 +2759,10 @@ void hostapd_ubus_notify_beacon_report(
 	struct hostapd_data *hapd, const u8 *addr, u8 token, u8 rep_mode,
 	struct rrm_measurement_beacon_report *rep, size_t len)
 {
-	if (!hapd->ubus.obj.has_subscribers)
+	if (!addr || !rep)
 		return;
 
-	if (!addr || !rep)
+	if (!hostapd_ubus_event_wanted(hapd, HOSTAPD_UBUS_EV_BEACON_REPORT))
 		return;
 
 	blob_buf_init(&b, 0);
@@ -2038,6 +2796,9 @@ void hostapd_ubus_notify_radar_detected(struct hostapd_iface *iface, int frequen
 
 	for (i = 0; i < iface->num_bss; i++) {
 		hapd = iface->bss[i];
+		if (!hostapd_ubus_event_wanted(hapd, HOSTAPD_UBUS_EV_RADAR_DETECTED))
+			continue;
+
 		ubus_notify(ctx, &hapd->ubus.obj, "radar-detected", b.head, -1);
 	}
 }
@@ -2068,10 +2829,10 @@ void hostapd_ubus_notify_bss_transition_response(
 #ifdef CONFIG_WNM_AP
 	u16 i;
 
-	if (!hapd->ubus.obj.has_subscribers)
+	if (!addr)
 		return;
 
-	if (!addr)
+	if (!hostapd_ubus_event_wanted(hapd, HOSTAPD_UBUS_EV_BSS_TR_RESPONSE))
 		return;
 
 	blob_buf_init(&b, 0);
@@ -2097,10 +2858,10 @@ int hostapd_ubus_notify_bss_transition_query(
 	char *cl_str;
 	u16 i;
 
-	if (!hapd->ubus.obj.has_subscribers)
+	if (!addr)
 		return 0;
 
-	if (!addr)
+	if (!hostapd_ubus_event_wanted(hapd, HOSTAPD_UBUS_EV_BSS_TR_QUERY))
 		return 0;
 
 	blob_buf_init(&b, 0);
@@ -33,10 +33,35 @@ struct rrm_measurement_beacon_report;
 #include <libubox/avl.h>
 #include <libubus.h>
 
+struct hostapd_ubus_verdict_stats {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long queries;
+	unsigned long replies;
+	unsigned long timeouts;
+	unsigned long sync_waits;
+	unsigned long long latency_sum; /* usec */
+	unsigned long latency_max;
+	unsigned long long blocked_sum; /* usec */
+	unsigned long blocked_max;
+};
+
 struct hostapd_ubus_bss {
 	struct ubus_object obj;
 	struct avl_tree banned;
 	int notify_response;
+
+	/* notify_response verdicts, per station */
+	struct avl_tree verdicts;
+	struct dl_list verdict_reqs;
+	unsigned int verdict_ttl; /* ms */
+	struct hostapd_ubus_verdict_stats verdict_stats;
+
+	/* events requested by subscribers through notify_events */
+	struct dl_list event_filters;
+	u32 event_mask;
+	unsigned long events_sent;
+	unsigned long events_suppressed;
 };
 
 void hostapd_ubus_add_iface(struct hostapd_iface *iface);
@@ -14,6 +14,8 @@
 #include "common/ieee802_11_defs.h"
 #include "wpa_supplicant_i.h"
 #include "wps_supplicant.h"
+#include "bss.h"
+#include "driver_i.h"
 #include "ubus.h"
 
 static struct ubus_context *ctx;
@@ -30,6 +32,16 @@ static inline struct wpa_supplicant *get_wpas_from_object(struct ubus_object *ob
 	return container_of(obj, struct wpa_supplicant, ubus.obj);
 }
 
+static void
+blobmsg_add_macaddr(struct blob_buf *buf, const char *name, const u8 *addr)
+{
+	char *s;
+
+	s = blobmsg_alloc_string_buffer(buf, name, 20);
+	sprintf(s, MACSTR, MAC2STR(addr));
+	blobmsg_add_string_buffer(buf);
+}
+
 static void ubus_receive(int sock, void *eloop_ctx, void *sock_ctx)
 {
 	struct ubus_context *ctx = eloop_ctx;
@@ -113,6 +125,77 @@ wpas_bss_reload(struct ubus_context *ctx, struct ubus_object *obj,
 		return 0;
 }
 
+static void
+wpas_ubus_add_current_bss(struct wpa_supplicant *wpa_s)
+{
+	struct wpa_bss *bss = wpa_s->current_bss;
+
+	if (is_zero_ether_addr(wpa_s->bssid))
+		return;
+
+	blobmsg_add_macaddr(&b, "bssid", wpa_s->bssid);
+	if (!bss)
+		return;
+
+	blobmsg_add_string(&b, "ssid", wpa_ssid_txt(bss->ssid, bss->ssid_len));
+	blobmsg_add_u32(&b, "freq", bss->freq);
+	blobmsg_add_u32(&b, "signal", bss->level);
+}
+
+static int
+wpas_bss_get_status(struct ubus_context *ctx, struct ubus_object *obj,
+		    struct ubus_request_data *req, const char *method,
+		    struct blob_attr *msg)
+{
+	struct wpa_supplicant *wpa_s = get_wpas_from_object(obj);
+
+	blob_buf_init(&b, 0);
+	blobmsg_add_string(&b, "state", wpa_supplicant_state_txt(wpa_s->wpa_state));
+	wpas_ubus_add_current_bss(wpa_s);
+	ubus_send_reply(ctx, req, b.head);
+
+	return 0;
+}
+
+enum {
+	SIGNAL_MONITOR_THRESHOLD,
+	SIGNAL_MONITOR_HYSTERESIS,
+	__SIGNAL_MONITOR_MAX
+};
+
+static const struct blobmsg_policy signal_monitor_policy[__SIGNAL_MONITOR_MAX] = {
+	[SIGNAL_MONITOR_THRESHOLD] = { "threshold", BLOBMSG_TYPE_INT32 },
+	[SIGNAL_MONITOR_HYSTERESIS] = { "hysteresis", BLOBMSG_TYPE_INT32 },
+};
+
+/* Threshold crossings are reported through the "signal" notification */
+static int
+wpas_bss_signal_monitor(struct ubus_context *ctx, struct ubus_object *obj,
+			struct ubus_request_data *req, const char *method,
+			struct blob_attr *msg)
+{
+	struct wpa_supplicant *wpa_s = get_wpas_from_object(obj);
+	struct blob_attr *tb[__SIGNAL_MONITOR_MAX];
+	int threshold = 0, hysteresis = 0;
+
+	blobmsg_parse(signal_monitor_policy, __SIGNAL_MONITOR_MAX, tb, blob_data(msg), blob_len(msg));
+
+	/* no threshold disables the monitor */
+	if (tb[SIGNAL_MONITOR_THRESHOLD])
+		threshold = (int) blobmsg_get_u32(tb[SIGNAL_MONITOR_THRESHOLD]);
+
+	if (tb[SIGNAL_MONITOR_HYSTERESIS])
+		hysteresis = (int) blobmsg_get_u32(tb[SIGNAL_MONITOR_HYSTERESIS]);
+
+	if (threshold > 0 || hysteresis < 0)
+		return UBUS_STATUS_INVALID_ARGUMENT;
+
+	if (wpa_drv_signal_monitor(wpa_s, threshold, hysteresis))
+		return UBUS_STATUS_NOT_SUPPORTED;
+
+	return 0;
+}
+
 #ifdef CONFIG_WPS
 enum {
 	WPS_START_MULTI_AP,
@@ -166,6 +249,8 @@ wpas_bss_wps_cancel(struct ubus_context *ctx, struct ubus_object *obj,
 static const struct ubus_method bss_methods[] = {
 	UBUS_METHOD_NOARG("reload", wpas_bss_reload),
 	UBUS_METHOD_NOARG("get_features", wpas_bss_get_features),
+	UBUS_METHOD_NOARG("get_status", wpas_bss_get_status),
+	UBUS_METHOD("signal_monitor", wpas_bss_signal_monitor, signal_monitor_policy),
 #ifdef CONFIG_WPS
 	UBUS_METHOD_NOARG("wps_start", wpas_bss_wps_start),
 	UBUS_METHOD_NOARG("wps_cancel", wpas_bss_wps_cancel),
@@ -356,6 +441,87 @@ void wpas_ubus_free(struct wpa_global *global)
 	free(name);
 }
 
+void wpas_ubus_notify_state(struct wpa_supplicant *wpa_s,
+			    enum wpa_states new_state,
+			    enum wpa_states old_state)
+{
+	if (!wpa_s->ubus.obj.has_subscribers)
+		return;
+
+	blob_buf_init(&b, 0);
+	blobmsg_add_string(&b, "state", wpa_supplicant_state_txt(new_state));
+	blobmsg_add_string(&b, "old_state", wpa_supplicant_state_txt(old_state));
+	if (new_state == WPA_COMPLETED)
+		wpas_ubus_add_current_bss(wpa_s);
+	else if (new_state == WPA_DISCONNECTED && old_state >= WPA_ASSOCIATED)
+		blobmsg_add_u32(&b, "reason", wpa_s->disconnect_reason);
+
+	ubus_notify(ctx, &wpa_s->ubus.obj, "state", b.head, -1);
+}
+
+/* Emitted on roams as well as on (dis)connects */
+void wpas_ubus_notify_bss(struct wpa_supplicant *wpa_s)
+{
+	if (!wpa_s->ubus.obj.has_subscribers)
+		return;
+
+	blob_buf_init(&b, 0);
+	wpas_ubus_add_current_bss(wpa_s);
+
+	ubus_notify(ctx, &wpa_s->ubus.obj, "bss", b.head, -1);
+}
+
+void wpas_ubus_notify_scan_done(struct wpa_supplicant *wpa_s, int success)
+{
+	struct wpa_bss *bss;
+	void *a, *t;
+	int count = 0;
+
+	if (!wpa_s->ubus.obj.has_subscribers)
+		return;
+
+	blob_buf_init(&b, 0);
+	blobmsg_add_u8(&b, "success", !!success);
+
+	/* only what the last scan saw, without the IEs */
+	a = blobmsg_open_array(&b, "results");
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		if (!success)
+			break;
+
+		if (bss->last_update_idx != wpa_s->bss_update_idx)
+			continue;
+
+		t = blobmsg_open_table(&b, NULL);
+		blobmsg_add_macaddr(&b, "bssid", bss->bssid);
+		blobmsg_add_string(&b, "ssid", wpa_ssid_txt(bss->ssid, bss->ssid_len));
+		blobmsg_add_u32(&b, "freq", bss->freq);
+		blobmsg_add_u32(&b, "signal", bss->level);
+		blobmsg_close_table(&b, t);
+		count++;
+	}
+	blobmsg_close_array(&b, a);
+	blobmsg_add_u32(&b, "count", count);
+
+	ubus_notify(ctx, &wpa_s->ubus.obj, "scan", b.head, -1);
+}
+
+void wpas_ubus_notify_signal(struct wpa_supplicant *wpa_s,
+			     const struct wpa_signal_info *si)
+{
+	if (!wpa_s->ubus.obj.has_subscribers)
+		return;
+
+	blob_buf_init(&b, 0);
+	blobmsg_add_u8(&b, "above", !!si->above_threshold);
+	blobmsg_add_u32(&b, "signal", si->current_signal);
+	blobmsg_add_u32(&b, "noise", si->current_noise);
+	blobmsg_add_u32(&b, "txrate", si->current_txrate);
+	if (!is_zero_ether_addr(wpa_s->bssid))
+		blobmsg_add_macaddr(&b, "bssid", wpa_s->bssid);
+
+	ubus_notify(ctx, &wpa_s->ubus.obj, "signal", b.head, -1);
+}
 
 #ifdef CONFIG_WPS
 void wpas_ubus_notify(struct wpa_supplicant *wpa_s, const struct wps_credential *cred)
@@ -11,7 +11,9 @@
 
 struct wpa_supplicant;
 struct wpa_global;
+struct wpa_signal_info;
 
+#include "common/defs.h"
 #include "wps_supplicant.h"
 
 #ifdef UBUS_SUPPORT
@@ -27,6 +29,14 @@ void wpas_ubus_free_bss(struct wpa_supplicant *wpa_s);
 void wpas_ubus_add(struct wpa_global *global);
 void wpas_ubus_free(struct wpa_global *global);
 
+void wpas_ubus_notify_state(struct wpa_supplicant *wpa_s,
+			    enum wpa_states new_state,
+			    enum wpa_states old_state);
+void wpas_ubus_notify_bss(struct wpa_supplicant *wpa_s);
+void wpas_ubus_notify_scan_done(struct wpa_supplicant *wpa_s, int success);
+void wpas_ubus_notify_signal(struct wpa_supplicant *wpa_s,
+			     const struct wpa_signal_info *si);
+
 #ifdef CONFIG_WPS
 void wpas_ubus_notify(struct wpa_supplicant *wpa_s, const struct wps_credential *cred);
 #endif
@@ -61,6 +71,25 @@ static inline void wpas_ubus_add(struct wpa_global *global)
 static inline void wpas_ubus_free(struct wpa_global *global)
 {
 }
+
+static inline void wpas_ubus_notify_state(struct wpa_supplicant *wpa_s,
+					  enum wpa_states new_state,
+					  enum wpa_states old_state)
+{
+}
+
+static inline void wpas_ubus_notify_bss(struct wpa_supplicant *wpa_s)
+{
+}
+
+static inline void wpas_ubus_notify_scan_done(struct wpa_supplicant *wpa_s, int success)
+{
+}
+
+static inline void wpas_ubus_notify_signal(struct wpa_supplicant *wpa_s,
+					   const struct wpa_signal_info *si)
+{
+}
 #endif
 
 #endif
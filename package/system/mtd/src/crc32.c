@@ -38,6 +38,14 @@
  */
 
 #include <stdint.h>
+#include <string.h>
+
+#include "crc32.h"
+
+#if defined(__ARM_FEATURE_CRC32) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CRC32_ARM 1
+#include <arm_acle.h>
+#endif
 
 const uint32_t crc32_table[256] = {
 	0x00000000L, 0x77073096L, 0xee0e612cL, 0x990951baL, 0x076dc419L,
@@ -93,3 +101,88 @@ const uint32_t crc32_table[256] = {
 	0x5d681b02L, 0x2a6f2b94L, 0xb40bbe37L, 0xc30c8ea1L, 0x5a05df1bL,
 	0x2d02ef8dL
 };
+
+#ifdef CRC32_ARM
+
+/* the ARMv8 CRC32 instructions use the same (reflected) polynomial */
+uint32_t
+crc32(uint32_t val, const void *ss, int len)
+{
+	const unsigned char *s = ss;
+	uint64_t v;
+
+	for (; len > 0 && ((uintptr_t) s & 7); len--)
+		val = __crc32b(val, *s++);
+
+	for (; len >= 8; len -= 8, s += 8) {
+		memcpy(&v, s, sizeof(v));
+		val = __crc32d(val, v);
+	}
+
+	while (--len >= 0)
+		val = __crc32b(val, *s++);
+
+	return val;
+}
+
+#else
+
+/*
+ *  Slicing-by-8: crc32_slice[n] holds the CRC contribution of a byte
+ *  followed by n zero bytes, so eight input bytes can be folded in with
+ *  independent table lookups instead of a serial chain of eight.  The
+ *  tables are derived from crc32_table on first use.
+ */
+static uint32_t crc32_slice[8][256];
+
+static void
+crc32_init(void)
+{
+	uint32_t c;
+	int i, n;
+
+	for (i = 0; i < 256; i++)
+		crc32_slice[0][i] = crc32_table[i];
+
+	for (i = 0; i < 256; i++) {
+		c = crc32_table[i];
+		for (n = 1; n < 8; n++) {
+			c = crc32_table[c & 0xff] ^ (c >> 8);
+			crc32_slice[n][i] = c;
+		}
+	}
+}
+
+uint32_t
+crc32(uint32_t val, const void *ss, int len)
+{
+	static int initialized;
+	const unsigned char *s = ss;
+	uint32_t lo, hi;
+
+	if (!initialized) {
+		crc32_init();
+		initialized = 1;
+	}
+
+	/* assembled byte by byte, so neither alignment nor endianness matter */
+	for (; len >= 8; len -= 8, s += 8) {
+		lo = val ^ (s[0] | s[1] << 8 | s[2] << 16 | (uint32_t) s[3] << 24);
+		hi = s[4] | s[5] << 8 | s[6] << 16 | (uint32_t) s[7] << 24;
+		val = crc32_slice[7][lo & 0xff] ^
+		      crc32_slice[6][(lo >> 8) & 0xff] ^
+		      crc32_slice[5][(lo >> 16) & 0xff] ^
+		      crc32_slice[4][lo >> 24] ^
+		      crc32_slice[3][hi & 0xff] ^
+		      crc32_slice[2][(hi >> 8) & 0xff] ^
+		      crc32_slice[1][(hi >> 16) & 0xff] ^
+		      crc32_slice[0][hi >> 24];
+	}
+
+	while (--len >= 0)
+		val = crc32_table[(val ^ *s++) & 0xff] ^ (val >> 8);
+
+	return val;
+}
+
+#endif
@@ -148,7 +148,7 @@ static uint32_t strntoul(char *str, char **endptr, int base, size_t len) {
 
 uint32_t compute_crc32(uint32_t crc, off_t start, size_t compute_len, int fd)
 {
-	uint8_t readbuf[1024];
+	static uint8_t readbuf[65536];
 	ssize_t res;
 	off_t offset = start;
 
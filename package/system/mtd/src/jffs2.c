@@ -70,6 +70,7 @@ static void pad(int size)
 		}
 		mtd_erase_block(outfd, mtdofs);
 		write(outfd, buf, erasesize);
+		mtd_crc_stream(mtdofs, buf, erasesize);
 		mtdofs += erasesize;
 	}
 }
@@ -34,6 +34,7 @@
 #include <sys/syscall.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <pthread.h>
 #include <time.h>
 #include <string.h>
 #include <sys/ioctl.h>
@@ -83,6 +84,7 @@ enum mtd_image_format {
 };
 
 static char *buf = NULL;
+static char *cmpbuf = NULL;
 static char *imagefile = NULL;
 static enum mtd_image_format imageformat = MTD_IMAGE_FORMAT_UNKNOWN;
 static char *jffs2file = NULL, *jffs2dir = JFFS2_DEFAULT_DIR;
@@ -90,6 +92,9 @@ static char *tpl_uboot_args_part;
 static int buflen = 0;
 int quiet;
 int no_erase;
+int skip_same;
+int verify_blocks;
+int show_timing;
 int mtdsize = 0;
 int erasesize = 0;
 int jffs2_skip_bytes=0;
@@ -184,6 +189,220 @@ int mtd_write_buffer(int fd, const char *buf, int offset, int length)
 	return 0;
 }
 
+/* number of erase block sized buffers read ahead from the image */
+#define PREFETCH_BUFS	2
+
+/*
+ * The image is read by a separate thread while the previous blocks are
+ * erased and written, which also keeps a decompressor feeding stdin busy.
+ */
+static struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int fd;
+	int active;
+	int blocksize;
+	char *data[PREFETCH_BUFS];
+	int len[PREFETCH_BUFS];
+	int err[PREFETCH_BUFS];
+	int head, tail, count, pos;
+} prefetch = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static struct {
+	uint64_t read, erase, write, verify;
+} timing;
+
+/*
+ * CRC of the TRX payload (flag_version up to trx->len), accumulated from
+ * the blocks as they are written so trx_fixup_crc() does not have to read
+ * the partition back after a jffs2 replacement.
+ */
+#define TRX_CRC_OFFSET	12
+
+static struct {
+	int active;
+	uint32_t pos, len, crc;
+} trx_stream;
+
+void mtd_crc_stream(int offset, const char *data, int len)
+{
+	uint32_t start = trx_stream.pos;
+	uint32_t from, to;
+
+	if (!trx_stream.active)
+		return;
+
+	/* bad block skipped or data out of order, fall back to trx_fixup() */
+	if (offset != trx_stream.pos) {
+		trx_stream.active = 0;
+		return;
+	}
+
+	trx_stream.pos += len;
+	from = start > TRX_CRC_OFFSET ? start : TRX_CRC_OFFSET;
+	to = trx_stream.pos < trx_stream.len ? trx_stream.pos : trx_stream.len;
+	if (from < to)
+		trx_stream.crc = crc32(trx_stream.crc, data + (from - start), to - from);
+}
+
+static uint64_t
+time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void *
+prefetch_thread(void *arg)
+{
+	int len, err, r;
+	char *data;
+
+	do {
+		pthread_mutex_lock(&prefetch.lock);
+		while (prefetch.count == PREFETCH_BUFS)
+			pthread_cond_wait(&prefetch.cond, &prefetch.lock);
+		data = prefetch.data[prefetch.head];
+		pthread_mutex_unlock(&prefetch.lock);
+
+		len = err = 0;
+		while (len < prefetch.blocksize) {
+			r = read(prefetch.fd, data + len, prefetch.blocksize - len);
+			if (r < 0) {
+				if ((errno == EINTR) || (errno == EAGAIN))
+					continue;
+				err = errno;
+				break;
+			}
+			if (r == 0)
+				break;
+			len += r;
+		}
+
+		pthread_mutex_lock(&prefetch.lock);
+		prefetch.len[prefetch.head] = len;
+		prefetch.err[prefetch.head] = err;
+		prefetch.head = (prefetch.head + 1) % PREFETCH_BUFS;
+		prefetch.count++;
+		pthread_cond_broadcast(&prefetch.cond);
+		pthread_mutex_unlock(&prefetch.lock);
+
+		/* a short block means end of input (or an error) */
+	} while (len == prefetch.blocksize);
+
+	return NULL;
+}
+
+static void
+prefetch_start(int fd)
+{
+	int i;
+
+	/*
+	 * erasesize changes when the write resumes on the next partition,
+	 * the buffers keep the size they were allocated with
+	 */
+	prefetch.blocksize = erasesize;
+	for (i = 0; i < PREFETCH_BUFS; i++) {
+		prefetch.data[i] = malloc(prefetch.blocksize);
+		if (!prefetch.data[i])
+			return;
+	}
+
+	prefetch.fd = fd;
+	if (pthread_create(&prefetch.thread, NULL, prefetch_thread, NULL))
+		return;
+
+	prefetch.active = 1;
+}
+
+static void
+prefetch_stop(void)
+{
+	if (!prefetch.active)
+		return;
+
+	pthread_join(prefetch.thread, NULL);
+	prefetch.active = 0;
+}
+
+/* read() replacement for the image, served by the prefetch thread if running */
+static ssize_t
+image_read(int fd, char *dest, int len)
+{
+	uint64_t start = time_us();
+	int cur, avail;
+	ssize_t ret;
+
+	if (!prefetch.active) {
+		ret = read(fd, dest, len);
+		timing.read += time_us() - start;
+		return ret;
+	}
+
+	pthread_mutex_lock(&prefetch.lock);
+	while (!prefetch.count)
+		pthread_cond_wait(&prefetch.cond, &prefetch.lock);
+	timing.read += time_us() - start;
+
+	cur = prefetch.tail;
+	avail = prefetch.len[cur] - prefetch.pos;
+	if (!avail) {
+		/* keep returning EOF or the error, the thread is done */
+		pthread_mutex_unlock(&prefetch.lock);
+		if (prefetch.err[cur]) {
+			errno = prefetch.err[cur];
+			return -1;
+		}
+		return 0;
+	}
+
+	if (len > avail)
+		len = avail;
+	memcpy(dest, prefetch.data[cur] + prefetch.pos, len);
+	prefetch.pos += len;
+
+	/* the last buffer stays queued so that EOF is seen again */
+	if (prefetch.pos == prefetch.len[cur] &&
+	    prefetch.len[cur] == prefetch.blocksize && !prefetch.err[cur]) {
+		prefetch.tail = (cur + 1) % PREFETCH_BUFS;
+		prefetch.count--;
+		prefetch.pos = 0;
+		pthread_cond_broadcast(&prefetch.cond);
+	}
+	pthread_mutex_unlock(&prefetch.lock);
+
+	return len;
+}
+
+/* compare the erase block at the current position against data */
+static int
+mtd_block_is_same(int fd, const char *data, int len)
+{
+	off_t pos;
+
+	pos = lseek(fd, 0, SEEK_CUR);
+	if (pos < 0 || pos % erasesize)
+		return 0;
+
+	if (!cmpbuf)
+		cmpbuf = malloc(erasesize);
+	if (!cmpbuf)
+		return 0;
+
+	/* read errors (e.g. ECC failures) mean the block gets rewritten */
+	if (pread(fd, cmpbuf, len, pos) != len)
+		return 0;
+
+	return !memcmp(cmpbuf, data, len);
+}
+
 static int
 image_check(int imagefd, const char *mtd)
 {
@@ -478,6 +697,9 @@ mtd_write(int imagefd, const char *mtd, char *fis_layout, size_t part_offset)
 	int buflen_raw = 0;
 	int jffs2_replaced = 0;
 	int skip_bad_blocks = 0;
+	int n_blocks = 0, n_same = 0;
+	uint64_t start_time = 0, t;
+	off_t pos;
 
 #ifdef FIS_SUPPORT
 	static struct fis_part new_parts[MAX_ARGS];
@@ -574,11 +796,28 @@ resume:
 
 	indicate_writing(mtd);
 
+	if (!prefetch.active && !start_time) {
+		start_time = time_us();
+		prefetch_start(imagefd);
+	}
+
 	w = e = 0;
+
+	trx_stream.active = imageformat == MTD_IMAGE_FORMAT_TRX && jffs2file &&
+			    trx_fixup_crc && !str && !part_offset && buflen >= 8;
+	if (trx_stream.active) {
+		const uint8_t *hdr = (const uint8_t *) buf;
+
+		trx_stream.pos = 0;
+		trx_stream.len = hdr[4] | (hdr[5] << 8) | (hdr[6] << 16) |
+				 ((uint32_t) hdr[7] << 24);
+		trx_stream.crc = 0xffffffff;
+	}
+
 	for (;;) {
 		/* buffer may contain data already (from trx check or last mtd partition write attempt) */
 		while (buflen < erasesize) {
-			r = read(imagefd, buf + buflen, erasesize - buflen);
+			r = image_read(imagefd, buf + buflen, erasesize - buflen);
 			if (r < 0) {
 				if ((errno == EINTR) || (errno == EAGAIN))
 					continue;
@@ -642,6 +881,24 @@ resume:
 			mtd_parse_jffs2data(buf, jffs2dir);
 		}
 
+		/*
+		 * leave blocks alone that already hold the data, as long as the
+		 * write starts a new (not yet erased) erase block
+		 */
+		n_blocks++;
+		if (skip_same && !offset && buflen == erasesize &&
+		    (no_erase || (w + skip_bad_blocks == e && !mtd_block_is_bad(fd, e))) &&
+		    mtd_block_is_same(fd, buf, buflen)) {
+			if (!quiet)
+				fprintf(stderr, "\b\b\b[s]");
+
+			lseek(fd, buflen, SEEK_CUR);
+			if (!no_erase)
+				e += erasesize;
+			n_same++;
+			goto written;
+		}
+
 		/* need to erase the next block before writing data to it */
 		if(!no_erase)
 		{
@@ -661,7 +918,10 @@ resume:
 					continue;
 				}
 
-				if (mtd_erase_block(fd, e + part_offset) < 0) {
+				t = time_us();
+				result = mtd_erase_block(fd, e + part_offset);
+				timing.erase += time_us() - t;
+				if (result < 0) {
 					if (next) {
 						if (w < e) {
 							write(fd, buf + offset, e - w);
@@ -687,7 +947,11 @@ resume:
 		if (!quiet)
 			fprintf(stderr, "\b\b\b[w]");
 
-		if ((result = write(fd, buf + offset, buflen)) < buflen) {
+		pos = lseek(fd, 0, SEEK_CUR);
+		t = time_us();
+		result = write(fd, buf + offset, buflen);
+		timing.write += time_us() - t;
+		if (result < buflen) {
 			if (result < 0) {
 				fprintf(stderr, "Error writing image.\n");
 				exit(1);
@@ -696,6 +960,22 @@ resume:
 				exit(1);
 			}
 		}
+
+		/* read the data back right away instead of a separate verify pass */
+		if (verify_blocks) {
+			t = time_us();
+			if (!cmpbuf)
+				cmpbuf = malloc(erasesize);
+			if (!cmpbuf || pread(fd, cmpbuf, buflen, pos) != buflen ||
+			    memcmp(cmpbuf, buf + offset, buflen)) {
+				fprintf(stderr, "\nVerification failed at 0x%08llx\n",
+					(unsigned long long) pos);
+				exit(1);
+			}
+			timing.verify += time_us() - t;
+		}
+written:
+		mtd_crc_stream(w + skip_bad_blocks, buf + offset, buflen);
 		w += buflen;
 
 #ifdef FIS_SUPPORT
@@ -716,8 +996,11 @@ resume:
 	if (jffs2_replaced) {
 		switch (imageformat) {
 		case MTD_IMAGE_FORMAT_TRX:
-			if (trx_fixup)
+			if (trx_stream.active && trx_stream.pos >= trx_stream.len)
+				trx_fixup_crc(fd, mtd, trx_stream.crc);
+			else if (trx_fixup)
 				trx_fixup(fd, mtd);
+			trx_stream.active = 0;
 			break;
 		case MTD_IMAGE_FORMAT_SEAMA:
 			if (mtd_fixseama)
@@ -742,6 +1025,21 @@ resume:
 	if (quiet < 2)
 		fprintf(stderr, "\n");
 
+	if (skip_same && quiet < 2)
+		fprintf(stderr, "Skipped %d of %d erase blocks with identical contents\n",
+			n_same, n_blocks);
+
+	prefetch_stop();
+
+	if (show_timing && start_time)
+		fprintf(stderr, "Processed %d blocks in %llu ms (read wait %llu ms, erase %llu ms, "
+			"write %llu ms, verify %llu ms)\n", n_blocks,
+			(unsigned long long) (time_us() - start_time) / 1000,
+			(unsigned long long) timing.read / 1000,
+			(unsigned long long) timing.erase / 1000,
+			(unsigned long long) timing.write / 1000,
+			(unsigned long long) timing.verify / 1000);
+
 #ifdef FIS_SUPPORT
 	if (fis_layout) {
 		if (fis_remap(old_parts, n_old, new_parts, n_new) < 0)
@@ -801,6 +1099,9 @@ static void usage(void)
 	"        -q                      quiet mode (once: no [w] on writing,\n"
 	"                                           twice: no status messages)\n"
 	"        -n                      write without first erasing the blocks\n"
+	"        -u                      skip erase blocks that already contain the data (for write)\n"
+	"        -v                      read back and compare every block after writing it (for write)\n"
+	"        -T                      print timing statistics (for write)\n"
 	"        -r                      reboot after successful command\n"
 	"        -f                      force write without trx checks\n"
 	"        -e <device>             erase <device> before executing the command\n"
@@ -874,12 +1175,15 @@ int main (int argc, char **argv)
 	buflen = 0;
 	quiet = 0;
 	no_erase = 0;
+	skip_same = 0;
+	verify_blocks = 0;
+	show_timing = 0;
 
 	while ((ch = getopt(argc, argv,
 #ifdef FIS_SUPPORT
 			"F:"
 #endif
-			"frnqe:d:s:j:p:o:c:t:l:M:")) != -1)
+			"frnuvTqe:d:s:j:p:o:c:t:l:M:")) != -1)
 		switch (ch) {
 			case 'f':
 				force = 1;
@@ -890,6 +1194,15 @@ int main (int argc, char **argv)
 			case 'n':
 				no_erase = 1;
 				break;
+			case 'u':
+				skip_same = 1;
+				break;
+			case 'v':
+				verify_blocks = 1;
+				break;
+			case 'T':
+				show_timing = 1;
+				break;
 			case 'j':
 				jffs2file = optarg;
 				break;
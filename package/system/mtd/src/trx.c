@@ -62,8 +62,8 @@ struct trx_header {
 ssize_t pread(int fd, void *buf, size_t count, off_t offset);
 ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset);
 
-int
-trx_fixup(int fd, const char *name)
+static int
+__trx_fixup(int fd, const char *name, const uint32_t *crc)
 {
 	struct mtd_info_user mtdInfo;
 	unsigned long len;
@@ -96,8 +96,12 @@ trx_fixup(int fd, const char *name)
 		goto err;
 	}
 
-	scan = ptr + offsetof(struct trx_header, flag_version);
-	trx->crc32 = crc32buf(scan, trx->len - (scan - ptr));
+	if (crc) {
+		trx->crc32 = *crc;
+	} else {
+		scan = ptr + offsetof(struct trx_header, flag_version);
+		trx->crc32 = crc32buf(scan, trx->len - (scan - ptr));
+	}
 	msync(ptr, sizeof(struct trx_header), MS_SYNC|MS_INVALIDATE);
 	munmap(ptr, len);
 	close(bfd);
@@ -109,6 +113,19 @@ err:
 	return -1;
 }
 
+int
+trx_fixup(int fd, const char *name)
+{
+	return __trx_fixup(fd, name, NULL);
+}
+
+/* like trx_fixup(), with the payload CRC already computed by the writer */
+int
+trx_fixup_crc(int fd, const char *name, uint32_t crc)
+{
+	return __trx_fixup(fd, name, &crc);
+}
+
 int
 trx_check(int imagefd, const char *mtd, char *buf, int *len)
 {
@@ -160,9 +177,11 @@ mtd_fixtrx(const char *mtd, size_t offset, size_t data_size)
 	int fd;
 	struct trx_header *trx;
 	char *first_block;
-	char *buf, *to;
+	char *buf;
 	ssize_t res;
 	size_t block_offset;
+	size_t crc_size = 0;
+	uint32_t crc = 0xffffffff;
 
 	if (quiet < 2)
 		fprintf(stderr, "Trying to fix trx header in %s at 0x%x...\n", mtd, offset);
@@ -205,13 +224,13 @@ mtd_fixtrx(const char *mtd, size_t offset, size_t data_size)
 		exit(1);
 	}
 
-	buf = malloc(data_size);
+	/* hash the data one erase block at a time instead of buffering it all */
+	buf = malloc(erasesize);
 	if (!buf) {
 		perror("malloc");
 		exit(1);
 	}
 
-	to = buf;
 	while (data_size) {
 		size_t read_block_offset = data_offset & ~(erasesize - 1);
 		size_t read_chunk;
@@ -221,21 +240,23 @@ mtd_fixtrx(const char *mtd, size_t offset, size_t data_size)
 
 		/* Read from good blocks only to match CFE behavior */
 		if (!mtd_block_is_bad(fd, read_block_offset)) {
-			res = pread(fd, to, read_chunk, data_offset);
+			res = pread(fd, buf, read_chunk, data_offset);
 			if (res != read_chunk) {
 				perror("pread");
 				exit(1);
 			}
-			to += read_chunk;
+			crc = crc32(crc, buf, read_chunk);
+			crc_size += read_chunk;
 		}
 
 		data_offset += read_chunk;
 		data_size -= read_chunk;
 	}
-	data_size = to - buf;
+	data_size = crc_size;
+	free(buf);
 
 	if (trx->len == STORE32_LE(data_size + TRX_CRC32_DATA_OFFSET) &&
-	    trx->crc32 == STORE32_LE(crc32buf(buf, data_size))) {
+	    trx->crc32 == STORE32_LE(crc)) {
 		if (quiet < 2)
 			fprintf(stderr, "Header already fixed, exiting\n");
 		close(fd);
@@ -244,7 +265,7 @@ mtd_fixtrx(const char *mtd, size_t offset, size_t data_size)
 
 	trx->len = STORE32_LE(data_size + offsetof(struct trx_header, flag_version));
 
-	trx->crc32 = STORE32_LE(crc32buf(buf, data_size));
+	trx->crc32 = STORE32_LE(crc);
 	if (mtd_erase_block(fd, block_offset)) {
 		fprintf(stderr, "Can't erease block at 0x%x (%s)\n", block_offset, strerror(errno));
 		exit(1);
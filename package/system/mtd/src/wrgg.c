@@ -52,34 +52,43 @@ wrgg_fix_md5(struct wrgg03_header *shdr, int fd, size_t data_offset, size_t data
 {
 	char *buf;
 	ssize_t res;
+	size_t pos, len;
 	MD5_CTX ctx;
 	unsigned char digest[16];
 	int i;
 	int err = 0;
 
-	buf = malloc(data_size);
+	/* hash the data one erase block at a time instead of buffering it all */
+	buf = malloc(erasesize);
 	if (!buf) {
 		err = -ENOMEM;
 		goto err_out;
 	}
 
-	res = pread(fd, buf, data_size, data_offset);
-	if (res != data_size) {
-		perror("pread");
-		err = -EIO;
-		goto err_free;
-	}
-
 	MD5_Init(&ctx);
 	MD5_Update(&ctx, (char *)&shdr->offset, sizeof(shdr->offset));
 	MD5_Update(&ctx, (char *)&shdr->dev_name, sizeof(shdr->dev_name));
-	MD5_Update(&ctx, buf, data_size);
+	for (pos = 0; pos < data_size; pos += len) {
+		len = data_size - pos;
+		if (len > erasesize)
+			len = erasesize;
+
+		res = pread(fd, buf, len, data_offset + pos);
+		if (res != len) {
+			perror("pread");
+			err = -EIO;
+			goto err_free;
+		}
+
+		MD5_Update(&ctx, buf, len);
+	}
 	MD5_Final(digest, &ctx);
 
 	if (!memcmp(digest, shdr->digest, sizeof(digest))) {
 		if (quiet < 2)
 			fprintf(stderr, "the header is fixed already\n");
-		return -1;
+		err = -1;
+		goto err_free;
 	}
 
 	if (quiet < 2) {
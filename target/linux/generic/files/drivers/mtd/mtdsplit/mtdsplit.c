@@ -15,9 +15,11 @@
 #include <linux/export.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/magic.h>
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/partitions.h>
+#include <linux/of.h>
 #include <linux/byteorder/generic.h>
 
 #include "mtdsplit.h"
@@ -67,11 +69,6 @@ int mtd_get_squashfs_len(struct mtd_info *master,
 }
 EXPORT_SYMBOL_GPL(mtd_get_squashfs_len);
 
-static ssize_t mtd_next_eb(struct mtd_info *mtd, size_t offset)
-{
-	return mtd_rounddown_to_eb(offset, mtd) + mtd->erasesize;
-}
-
 int mtd_check_rootfs_magic(struct mtd_info *mtd, size_t offset,
 			   enum mtdsplit_part_type *type)
 {
@@ -105,26 +102,93 @@ int mtd_check_rootfs_magic(struct mtd_info *mtd, size_t offset,
 }
 EXPORT_SYMBOL_GPL(mtd_check_rootfs_magic);
 
-int mtd_find_rootfs_from(struct mtd_info *mtd,
-			 size_t from,
-			 size_t limit,
-			 size_t *ret_offset,
-			 enum mtdsplit_part_type *type)
+static bool mtd_skip_bad_eb(struct mtd_info *mtd, size_t offset)
+{
+	if (!mtd_can_have_bb(mtd))
+		return false;
+
+	return mtd_block_isbad(mtd, mtd_rounddown_to_eb(offset, mtd)) > 0;
+}
+
+/*
+ * Look for a rootfs between @from and @limit.
+ *
+ * @hint is probed first, even below @from. Parsers pass the rootfs offset
+ * or kernel end taken from their image header here. The search afterwards
+ * only probes offsets aligned to @step (0 means one erase block). Both the window and
+ * the step can be narrowed per partition in the device tree through the
+ * "openwrt,rootfs-search-window" and "openwrt,rootfs-search-step"
+ * properties, so a missing rootfs doesn't cost a read of every erase
+ * block of a large NAND partition at boot.
+ */
+int mtd_find_rootfs_window(struct mtd_info *mtd,
+			   size_t from,
+			   size_t limit,
+			   size_t hint,
+			   size_t step,
+			   size_t *ret_offset,
+			   enum mtdsplit_part_type *type)
 {
+	struct device_node *np = mtd_get_of_node(mtd);
+	unsigned int probes = 0;
+	ktime_t start;
 	size_t offset;
-	int err;
+	u32 val;
+	int err = -ENODEV;
+
+	if (!of_property_read_u32(np, "openwrt,rootfs-search-window", &val) &&
+	    val && from + val < limit)
+		limit = from + val;
+
+	if (!step && !of_property_read_u32(np, "openwrt,rootfs-search-step",
+					   &val))
+		step = val;
+
+	step = roundup(max_t(size_t, step, 1), mtd->erasesize);
+	start = ktime_get();
+
+	if (hint < limit && !mtd_skip_bad_eb(mtd, hint)) {
+		probes++;
+		err = mtd_check_rootfs_magic(mtd, hint, type);
+		if (!err) {
+			offset = hint;
+			goto out;
+		}
+	}
 
 	for (offset = from; offset < limit;
-	     offset = mtd_next_eb(mtd, offset)) {
-		err = mtd_check_rootfs_magic(mtd, offset, type);
-		if (err)
+	     offset = rounddown(offset, step) + step) {
+		if (offset == hint || mtd_skip_bad_eb(mtd, offset))
 			continue;
 
-		*ret_offset = offset;
-		return 0;
+		probes++;
+		err = mtd_check_rootfs_magic(mtd, offset, type);
+		if (!err)
+			goto out;
 	}
 
-	return -ENODEV;
+	err = -ENODEV;
+
+out:
+	if (err || probes > 1)
+		pr_info("%s rootfs in \"%s\" after %u probes in %lld us\n",
+			err ? "no" : "found", mtd->name, probes,
+			ktime_us_delta(ktime_get(), start));
+
+	if (!err)
+		*ret_offset = offset;
+
+	return err;
 }
-EXPORT_SYMBOL_GPL(mtd_find_rootfs_from);
+EXPORT_SYMBOL_GPL(mtd_find_rootfs_window);
 
+int mtd_find_rootfs_from(struct mtd_info *mtd,
+			 size_t from,
+			 size_t limit,
+			 size_t *ret_offset,
+			 enum mtdsplit_part_type *type)
+{
+	return mtd_find_rootfs_window(mtd, from, limit, from, 0,
+				      ret_offset, type);
+}
+EXPORT_SYMBOL_GPL(mtd_find_rootfs_from);
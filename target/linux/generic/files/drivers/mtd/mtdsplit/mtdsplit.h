@@ -40,6 +40,14 @@ int mtd_find_rootfs_from(struct mtd_info *mtd,
 			 size_t *ret_offset,
 			 enum mtdsplit_part_type *type);
 
+int mtd_find_rootfs_window(struct mtd_info *mtd,
+			   size_t from,
+			   size_t limit,
+			   size_t hint,
+			   size_t step,
+			   size_t *ret_offset,
+			   enum mtdsplit_part_type *type);
+
 #else
 static inline int mtd_get_squashfs_len(struct mtd_info *master,
 				       size_t offset,
@@ -62,6 +70,17 @@ static inline int mtd_find_rootfs_from(struct mtd_info *mtd,
 {
 	return -ENODEV;
 }
+
+static inline int mtd_find_rootfs_window(struct mtd_info *mtd,
+					 size_t from,
+					 size_t limit,
+					 size_t hint,
+					 size_t step,
+					 size_t *ret_offset,
+					 enum mtdsplit_part_type *type)
+{
+	return -ENODEV;
+}
 #endif /* CONFIG_MTD_SPLIT */
 
 #endif /* _MTDSPLIT_H */
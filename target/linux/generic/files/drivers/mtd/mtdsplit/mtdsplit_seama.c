@@ -58,22 +58,17 @@ static int mtdsplit_parse_seama(struct mtd_info *master,
 	if (kernel_ent_size > master->size)
 		return -EINVAL;
 
-	/* Check for the rootfs right after Seama entity with a kernel. */
-	err = mtd_check_rootfs_magic(master, kernel_ent_size, &type);
-	if (!err) {
-		rootfs_offset = kernel_ent_size;
-	} else {
-		/*
-		 * On some devices firmware entity might contain both: kernel
-		 * and rootfs. We can't determine kernel size so we just have to
-		 * look for rootfs magic.
-		 * Start the search from an arbitrary offset.
-		 */
-		err = mtd_find_rootfs_from(master, SEAMA_MIN_ROOTFS_OFFS,
-					   master->size, &rootfs_offset, &type);
-		if (err)
-			return err;
-	}
+	/*
+	 * Check for the rootfs right after Seama entity with a kernel first.
+	 * On some devices firmware entity might contain both: kernel and
+	 * rootfs. We can't determine kernel size so we just have to look for
+	 * rootfs magic, starting the search from an arbitrary offset.
+	 */
+	err = mtd_find_rootfs_window(master, SEAMA_MIN_ROOTFS_OFFS,
+				     master->size, kernel_ent_size, 0,
+				     &rootfs_offset, &type);
+	if (err)
+		return err;
 
 	parts = kzalloc(SEAMA_NR_PARTS * sizeof(*parts), GFP_KERNEL);
 	if (!parts)
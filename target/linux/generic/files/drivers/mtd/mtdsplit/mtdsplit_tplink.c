@@ -124,18 +124,16 @@ static int mtdsplit_parse_tplink(struct mtd_info *master,
 	if (kernel_size > master->size)
 		return -EINVAL;
 
-	/* Find the rootfs */
-	err = mtd_check_rootfs_magic(master, rootfs_offset, NULL);
-	if (err) {
-		/*
-		 * The size in the header might cover the rootfs as well.
-		 * Start the search from an arbitrary offset.
-		 */
-		err = mtd_find_rootfs_from(master, TPLINK_MIN_ROOTFS_OFFS,
-					   master->size, &rootfs_offset, NULL);
-		if (err)
-			return err;
-	}
+	/*
+	 * Find the rootfs, trying the offset from the header first.
+	 * The size in the header might cover the rootfs as well, so
+	 * fall back to a search from an arbitrary offset.
+	 */
+	err = mtd_find_rootfs_window(master, TPLINK_MIN_ROOTFS_OFFS,
+				     master->size, rootfs_offset, 0,
+				     &rootfs_offset, NULL);
+	if (err)
+		return err;
 
 	parts = kzalloc(TPLINK_NR_PARTS * sizeof(*parts), GFP_KERNEL);
 	if (!parts)
@@ -12,6 +12,7 @@
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/mtd/mtd.h>
@@ -23,6 +24,12 @@
 
 #include "mtdsplit.h"
 
+/*
+ * With erase blocks smaller than this, candidate headers are read this many
+ * bytes at a time and checked in memory instead of one mtd_read each.
+ */
+#define UIMAGE_SCAN_CHUNK	(64 * 1024)
+
 /*
  * Legacy format image header,
  * all data in network byte order (aka natural aka bigendian).
@@ -63,6 +70,50 @@ read_uimage_header(struct mtd_info *mtd, size_t offset, u_char *buf,
 	return 0;
 }
 
+struct uimage_scan {
+	u_char *buf;
+	size_t len;
+	size_t offset;
+	size_t end;
+	bool valid;
+};
+
+/*
+ * Return the header_len bytes at offset, served from the scan chunk when
+ * possible. Falls back to a plain header read into buf, also for the rest
+ * of a chunk that could not be read in one go. Offset 0 is always read on
+ * its own, that's where the header is on most devices.
+ */
+static u_char *
+uimage_scan_read(struct mtd_info *mtd, struct uimage_scan *scan,
+		 size_t offset, u_char *buf, size_t header_len)
+{
+	size_t retlen;
+	size_t len;
+	int ret;
+
+	if (!scan->buf || !offset)
+		goto direct;
+
+	if (offset < scan->offset || offset >= scan->end) {
+		len = min_t(size_t, scan->len, mtd->size - offset);
+		ret = mtd_read(mtd, offset, len, &retlen, scan->buf);
+
+		scan->offset = offset;
+		scan->end = offset + len;
+		scan->valid = !ret && retlen == len;
+	}
+
+	if (scan->valid && offset + header_len <= scan->end)
+		return scan->buf + (offset - scan->offset);
+
+direct:
+	if (read_uimage_header(mtd, offset, buf, header_len))
+		return NULL;
+
+	return buf;
+}
+
 static void uimage_parse_dt(struct mtd_info *master, int *extralen,
 			    u32 *ih_magic, u32 *ih_type,
 			    u32 *header_offset, u32 *part_magic)
@@ -121,7 +172,10 @@ static int __mtdsplit_parse_uimage(struct mtd_info *master,
 				   struct mtd_part_parser_data *data)
 {
 	struct mtd_partition *parts;
+	struct uimage_scan scan = {};
+	ktime_t start;
 	u_char *buf;
+	u_char *hdr;
 	int nr_parts;
 	size_t offset;
 	size_t uimage_offset;
@@ -151,28 +205,36 @@ static int __mtdsplit_parse_uimage(struct mtd_info *master,
 		goto err_free_parts;
 	}
 
+	if (master->erasesize < UIMAGE_SCAN_CHUNK &&
+	    buflen <= master->erasesize) {
+		scan.len = UIMAGE_SCAN_CHUNK;
+		scan.buf = vmalloc(scan.len);
+	}
+
+	start = ktime_get();
+
 	/* find uImage on erase block boundaries */
 	for (offset = 0; offset < master->size; offset += master->erasesize) {
 		struct uimage_header *header;
 
 		uimage_size = 0;
 
-		ret = read_uimage_header(master, offset, buf, buflen);
-		if (ret)
+		hdr = uimage_scan_read(master, &scan, offset, buf, buflen);
+		if (!hdr)
 			continue;
 
 		/* verify optional partition magic before uimage header */
-		if (header_offset && part_magic && (be32_to_cpu(*(u32 *)buf) != part_magic))
+		if (header_offset && part_magic && (be32_to_cpu(*(u32 *)hdr) != part_magic))
 			continue;
 
-		ret = uimage_verify_default(buf + header_offset, ih_magic, ih_type);
+		ret = uimage_verify_default(hdr + header_offset, ih_magic, ih_type);
 		if (ret < 0) {
 			pr_debug("no valid uImage found in \"%s\" at offset %llx\n",
 				 master->name, (unsigned long long) offset);
 			continue;
 		}
 
-		header = (struct uimage_header *)(buf + header_offset);
+		header = (struct uimage_header *)(hdr + header_offset);
 
 		uimage_size = sizeof(*header) +
 				be32_to_cpu(header->ih_size) + header_offset + extralen;
@@ -185,6 +247,10 @@ static int __mtdsplit_parse_uimage(struct mtd_info *master,
 		break;
 	}
 
+	pr_debug("uImage search in \"%s\" took %lld us\n", master->name,
+		 ktime_us_delta(ktime_get(), start));
+	vfree(scan.buf);
+
 	if (uimage_size == 0) {
 		pr_debug("no uImage found in \"%s\"\n", master->name);
 		ret = -ENODEV;
@@ -17,6 +17,7 @@
 #include <linux/gfp.h>
 #include <linux/slab.h>
 #include <linux/bits.h>
+#include <linux/ktime.h>
 #include "mtk_bmt.h"
 
 struct bmt_desc bmtd = {};
@@ -92,6 +93,18 @@ bool mapping_block_in_range(int block, int *start, int *end)
 	return false;
 }
 
+static int
+mtk_bmt_get_mapping_block(int block)
+{
+	int cur_block = bmtd.ops->get_mapping_block(block);
+
+	bmtd.remap_lookups++;
+	if (cur_block != block)
+		bmtd.remap_hits++;
+
+	return cur_block;
+}
+
 static bool
 mtk_bmt_remap_block(u32 block, u32 mapped_block, int copy_len)
 {
@@ -123,7 +136,7 @@ mtk_bmt_read(struct mtd_info *mtd, loff_t from,
 		u32 block = from >> bmtd.blk_shift;
 		int cur_block;
 
-		cur_block = bmtd.ops->get_mapping_block(block);
+		cur_block = mtk_bmt_get_mapping_block(block);
 		if (cur_block < 0)
 			return -EIO;
 
@@ -188,7 +201,7 @@ mtk_bmt_write(struct mtd_info *mtd, loff_t to,
 		u32 block = to >> bmtd.blk_shift;
 		int cur_block;
 
-		cur_block = bmtd.ops->get_mapping_block(block);
+		cur_block = mtk_bmt_get_mapping_block(block);
 		if (cur_block < 0)
 			return -EIO;
 
@@ -242,7 +255,7 @@ mtk_bmt_mtd_erase(struct mtd_info *mtd, struct erase_info *instr)
 
 	while (start_addr < end_addr) {
 		orig_block = start_addr >> bmtd.blk_shift;
-		block = bmtd.ops->get_mapping_block(orig_block);
+		block = mtk_bmt_get_mapping_block(orig_block);
 		if (block < 0)
 			return -EIO;
 		mapped_instr.addr = (loff_t)block << bmtd.blk_shift;
@@ -269,7 +282,7 @@ mtk_bmt_block_isbad(struct mtd_info *mtd, loff_t ofs)
 	int ret;
 
 retry:
-	block = bmtd.ops->get_mapping_block(orig_block);
+	block = mtk_bmt_get_mapping_block(orig_block);
 	ret = bmtd._block_isbad(mtd, (loff_t)block << bmtd.blk_shift);
 	if (ret) {
 		if (mtk_bmt_remap_block(orig_block, block, bmtd.blk_size) &&
@@ -285,7 +298,7 @@ mtk_bmt_block_markbad(struct mtd_info *mtd, loff_t ofs)
 	u16 orig_block = ofs >> bmtd.blk_shift;
 	int block;
 
-	block = bmtd.ops->get_mapping_block(orig_block);
+	block = mtk_bmt_get_mapping_block(orig_block);
 	if (block < 0)
 		return -EIO;
 
@@ -378,6 +391,13 @@ mtk_bmt_add_debugfs(void)
 	debugfs_create_file_unsafe("mark_good", S_IWUSR, dir, NULL, &fops_mark_good);
 	debugfs_create_file_unsafe("mark_bad", S_IWUSR, dir, NULL, &fops_mark_bad);
 	debugfs_create_file_unsafe("debug", S_IWUSR, dir, NULL, &fops_debug);
+	debugfs_create_u64("remap_lookups", S_IRUSR, dir, &bmtd.remap_lookups);
+	debugfs_create_u64("remap_hits", S_IRUSR, dir, &bmtd.remap_hits);
+	debugfs_create_u32("pages_read", S_IRUSR, dir, &bmtd.pages_read);
+	debugfs_create_u32("attach_pages_read", S_IRUSR, dir,
+			   &bmtd.attach_pages_read);
+	debugfs_create_u64("attach_time_us", S_IRUSR, dir,
+			   &bmtd.attach_time_us);
 }
 
 void mtk_bmt_detach(struct mtd_info *mtd)
@@ -390,6 +410,8 @@ void mtk_bmt_detach(struct mtd_info *mtd)
 	bmtd.debugfs_dir = NULL;
 
 	kfree(bmtd.bbt_buf);
+	kfree(bmtd.bbt_map);
+	kfree(bmtd.bbt_map_next);
 	kfree(bmtd.data_buf);
 
 	mtd->_read_oob = bmtd._read_oob;
@@ -406,6 +428,7 @@ void mtk_bmt_detach(struct mtd_info *mtd)
 int mtk_bmt_attach(struct mtd_info *mtd)
 {
 	struct device_node *np;
+	ktime_t start;
 	int ret = 0;
 
 	if (bmtd.mtd)
@@ -446,10 +469,17 @@ int mtk_bmt_attach(struct mtd_info *mtd)
 
 	memset(bmtd.data_buf, 0xff, bmtd.pg_size + bmtd.mtd->oobsize);
 
+	start = ktime_get();
+
 	ret = bmtd.ops->init(np);
 	if (ret)
 		goto error;
 
+	bmtd.attach_time_us = ktime_us_delta(ktime_get(), start);
+	bmtd.attach_pages_read = bmtd.pages_read;
+	pr_info("nand: bmt attached in %llu us, %u pages read\n",
+		bmtd.attach_time_us, bmtd.attach_pages_read);
+
 	mtk_bmt_add_debugfs();
 	return 0;
 
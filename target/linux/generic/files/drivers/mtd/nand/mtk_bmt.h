@@ -48,6 +48,10 @@ struct bmt_desc {
 
 	struct dentry *debugfs_dir;
 
+	/* logical to physical block lookup of the bbt backend */
+	u16 *bbt_map;
+	u16 *bbt_map_next;
+
 	u32 table_size;
 	u32 pg_size;
 	u32 blk_size;
@@ -71,6 +75,15 @@ struct bmt_desc {
 
 	/* to compensate for driver level remapping */
 	u8 oob_offset;
+
+	/* mapping lookups on the I/O path, and how many were remapped */
+	u64 remap_lookups;
+	u64 remap_hits;
+
+	/* pages read from the chip, and the share of it spent on attach */
+	u32 pages_read;
+	u32 attach_pages_read;
+	u64 attach_time_us;
 };
 
 extern struct bmt_desc bmtd;
@@ -96,6 +109,8 @@ bbt_nand_read(u32 page, unsigned char *dat, int dat_len,
 		.len = dat_len,
 	};
 
+	bmtd.pages_read += max_t(u32, 1, DIV_ROUND_UP(dat_len, bmtd.pg_size));
+
 	return bmtd._read_oob(bmtd.mtd, page << bmtd.pg_shift, &ops);
 }
 
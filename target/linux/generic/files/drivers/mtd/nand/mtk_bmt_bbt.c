@@ -25,6 +25,60 @@ bbt_block_is_bad(u16 block)
 	return cur & (3 << ((block % 4) * 2));
 }
 
+/*
+ * Logical blocks of a range map to its good blocks in order. Once those run
+ * out, the remaining logical blocks map to the bad blocks in order.
+ */
+static void
+bbt_build_map_range(u16 *map, int start, int end)
+{
+	int good = start, bad = start;
+	int i;
+
+	end = min_t(int, end, bmtd.total_blks);
+	for (i = start; i < end; i++) {
+		while (good < end && bbt_block_is_bad(good))
+			good++;
+
+		if (good < end) {
+			map[i] = good++;
+			continue;
+		}
+
+		while (bad < end && !bbt_block_is_bad(bad))
+			bad++;
+
+		map[i] = bad < end ? bad++ : i;
+	}
+}
+
+/*
+ * The map is built aside and only the entries that changed are written
+ * back, so a concurrent lookup sees either the old or the new mapping of a
+ * block. Without a remap range, blocks are not remapped at all.
+ */
+static void
+bbt_build_map(void)
+{
+	const __be32 *cur = bmtd.remap_range;
+	u16 *map = bmtd.bbt_map_next;
+	int i;
+
+	for (i = 0; i < bmtd.total_blks; i++)
+		map[i] = i;
+
+	if (cur) {
+		for (i = 0; i < bmtd.remap_range_len; i++, cur += 2)
+			bbt_build_map_range(map,
+					    be32_to_cpu(cur[0]) >> bmtd.blk_shift,
+					    be32_to_cpu(cur[1]) >> bmtd.blk_shift);
+	}
+
+	for (i = 0; i < bmtd.total_blks; i++)
+		if (bmtd.bbt_map[i] != map[i])
+			WRITE_ONCE(bmtd.bbt_map[i], map[i]);
+}
+
 static void
 bbt_set_block_state(u16 block, bool bad)
 {
@@ -35,6 +89,8 @@ bbt_set_block_state(u16 block, bool bad)
 	else
 		bmtd.bbt_buf[block / 4] &= ~mask;
 
+	bbt_build_map();
+
 	bbt_nand_erase(bmtd.bmt_blk_idx);
 	write_bmt(bmtd.bmt_blk_idx, bmtd.bbt_buf);
 }
@@ -42,40 +98,10 @@ bbt_set_block_state(u16 block, bool bad)
 static int
 get_mapping_block_index_bbt(int block)
 {
-	int start, end, ofs;
-	int bad_blocks = 0;
-	int i;
-
-	if (!mapping_block_in_range(block, &start, &end))
+	if (block >= bmtd.total_blks)
 		return block;
 
-	start >>= bmtd.blk_shift;
-	end >>= bmtd.blk_shift;
-	/* skip bad blocks within the mapping range */
-	ofs = block - start;
-	for (i = start; i < end; i++) {
-		if (bbt_block_is_bad(i))
-			bad_blocks++;
-		else if (ofs)
-			ofs--;
-		else
-			break;
-	}
-
-	if (i < end)
-		return i;
-
-	/* when overflowing, remap remaining blocks to bad ones */
-	for (i = end - 1; bad_blocks > 0; i--) {
-		if (!bbt_block_is_bad(i))
-			continue;
-
-		bad_blocks--;
-		if (bad_blocks <= ofs)
-			return i;
-	}
-
-	return block;
+	return READ_ONCE(bmtd.bbt_map[block]);
 }
 
 static bool remap_block_bbt(u16 block, u16 mapped_blk, int copy_len)
@@ -154,6 +180,16 @@ mtk_bmt_init_bbt(struct device_node *np)
 	if (ret)
 		return ret;
 
+	bmtd.bbt_map = kcalloc(bmtd.total_blks, sizeof(*bmtd.bbt_map),
+			       GFP_KERNEL);
+	bmtd.bbt_map_next = kmalloc_array(bmtd.total_blks,
+					  sizeof(*bmtd.bbt_map_next),
+					  GFP_KERNEL);
+	if (!bmtd.bbt_map || !bmtd.bbt_map_next)
+		return -ENOMEM;
+
+	bbt_build_map();
+
 	bmtd.bmt_pgs = buf_size / bmtd.pg_size;
 
 	return 0;
@@ -245,6 +245,7 @@ static int nmbm_read_phys_page(struct nmbm_instance *ni, uint64_t addr,
 		if (oob)
 			ops.ooblen = mtd_oobavail(bmtd.mtd, &ops);
 
+		bmtd.pages_read++;
 		ret = bmtd._read_oob(bmtd.mtd, addr, &ops);
 		if (ret == -EUCLEAN)
 			return min_t(u32, bmtd.mtd->bitflip_threshold + 1,
@@ -1770,18 +1771,33 @@ static bool nmbm_try_load_info_table(struct nmbm_instance *ni, uint32_t ba,
 		if (chunksize > bmtd.blk_size)
 			chunksize = bmtd.blk_size;
 
+		/*
+		 * Check the header page before reading the rest of the first
+		 * block, most blocks probed by the search don't hold a table.
+		 */
+		if (checkhdr) {
+			ret = nmbn_read_data(ni, ba2addr(ni, ba), off,
+					     bmtd.pg_size);
+			if (!ret && !nmbm_check_info_table_header(ni, off))
+				return false;
+
+			if (!ret)
+				ret = nmbn_read_data(ni,
+					ba2addr(ni, ba) + bmtd.pg_size,
+					off + bmtd.pg_size,
+					chunksize - bmtd.pg_size);
+		} else {
+			ret = nmbn_read_data(ni, ba2addr(ni, ba), off,
+					     chunksize);
+		}
+
 		/* Assume block with ECC error has no info table data */
-		ret = nmbn_read_data(ni, ba2addr(ni, ba), off, chunksize);
 		if (ret < 0)
 			goto skip_bad_block;
 		else if (ret > 0)
 			return false;
 
 		if (checkhdr) {
-			success = nmbm_check_info_table_header(ni, off);
-			if (!success)
-				return false;
-
 			start_ba = ba;
 			checkhdr = false;
 		}
@@ -929,6 +929,9 @@ struct msdc_host {
 	int                         irq;            /* host interrupt */
 
 	struct delayed_work		card_delaywork;
+	struct delayed_work		req_timeout_work; /* fails data requests after DAT_TIMEOUT */
+	unsigned long               req_timeout;    /* jiffies, data request deadline */
+	bool                        req_async;      /* msdc_irq_thread owns host->mrq */
 
 	struct completion           cmd_done;
 	struct completion           xfer_done;
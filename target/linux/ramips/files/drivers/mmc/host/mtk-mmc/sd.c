@@ -39,6 +39,7 @@
 #include <linux/spinlock.h>
 #include <linux/platform_device.h>
 #include <linux/interrupt.h>
+#include <linux/iopoll.h>
 #include <linux/of.h>
 
 #include <linux/mmc/host.h>
@@ -91,6 +92,10 @@
 
 #define MAX_DMA_CNT         (64 * 1024 - 512)   /* a single transaction for WIFI may be 50K*/
 
+/* mmc_data.host_cookie */
+#define MSDC_PREPARE_FLAG   BIT(0)  /* sg list is DMA mapped */
+#define MSDC_ASYNC_FLAG     BIT(1)  /* mapped by pre_req, unmapped by post_req */
+
 #define MAX_GPD_NUM         (1 + 1)  /* one null gpd */
 #define MAX_BD_NUM          (1024)
 #define MAX_BD_PER_GPD      (MAX_BD_NUM)
@@ -1021,12 +1026,19 @@ static void msdc_dma_stop(struct msdc_host *host)
 	//u32 retries=500;
 	u32 wints = MSDC_INTEN_XFER_COMPL | MSDC_INTEN_DATTMO | MSDC_INTEN_DATCRCERR;
 
+	u32 val;
+
 	N_MSG(DMA, "DMA status: 0x%.8x", sdr_read32(MSDC_DMA_CFG));
-	//while (sdr_read32(MSDC_DMA_CFG) & MSDC_DMA_CFG_STS);
 
-	sdr_set_field(MSDC_DMA_CTRL, MSDC_DMA_CTRL_STOP, 1);
-	while (sdr_read32(MSDC_DMA_CFG) & MSDC_DMA_CFG_STS)
-		;
+	/* after XFER_COMPL the engine is normally idle already, only an
+	   aborted transfer has to be stopped and waited for */
+	if (sdr_read32(MSDC_DMA_CFG) & MSDC_DMA_CFG_STS) {
+		sdr_set_field(MSDC_DMA_CTRL, MSDC_DMA_CTRL_STOP, 1);
+		if (readl_poll_timeout_atomic(MSDC_DMA_CFG, val,
+					      !(val & MSDC_DMA_CFG_STS),
+					      1, 20000))
+			ERR_MSG("DMA stop timeout, DMA_CFG = 0x%x", val);
+	}
 
 	//dsb(); /* --- by chhung */
 	sdr_clr_bits(MSDC_INTEN, wints); /* Not just xfer_comp */
@@ -1137,13 +1149,137 @@ static void msdc_dma_setup(struct msdc_host *host, struct msdc_dma *dma,
 	msdc_dma_config(host, dma);
 }
 
+static void msdc_prepare_data(struct msdc_host *host, struct mmc_data *data)
+{
+	if (data->host_cookie & MSDC_PREPARE_FLAG)
+		return;
+
+	data->sg_count = dma_map_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+				    mmc_get_dma_dir(data));
+	if (data->sg_count)
+		data->host_cookie |= MSDC_PREPARE_FLAG;
+}
+
+static void msdc_unprepare_data(struct msdc_host *host, struct mmc_data *data)
+{
+	/* mapped by pre_req, post_req unmaps it */
+	if (data->host_cookie & MSDC_ASYNC_FLAG)
+		return;
+
+	if (data->host_cookie & MSDC_PREPARE_FLAG) {
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			     mmc_get_dma_dir(data));
+		data->host_cookie &= ~MSDC_PREPARE_FLAG;
+	}
+}
+
+/* sets up the data phase of mrq up to the DMA start, 0 on success */
+static int msdc_start_data(struct msdc_host *host, struct mmc_request *mrq)
+	__must_hold(&host->lock)
+{
+	struct mmc_command *cmd = mrq->cmd;
+	struct mmc_data *data = cmd->data;
+	void __iomem *base = host->base;
+
+	BUG_ON(data->blksz > HOST_MAX_BLKSZ);
+
+	data->error = 0;
+	host->data = data;
+	host->xfer_size = data->blocks * data->blksz;
+	host->blksz = data->blksz;
+
+	if (data->flags & MMC_DATA_READ) {
+		if ((host->timeout_ns != data->timeout_ns) ||
+			(host->timeout_clks != data->timeout_clks)) {
+			msdc_set_timeout(host, data->timeout_ns, data->timeout_clks);
+		}
+	}
+
+	sdr_write32(SDC_BLK_NUM, data->blocks);
+	//msdc_clr_fifo();  /* no need */
+
+	msdc_dma_on();  /* enable DMA mode first!! */
+	init_completion(&host->xfer_done);
+
+	/* already done by pre_req for requests queued ahead */
+	msdc_prepare_data(host, data);
+	if (!(data->host_cookie & MSDC_PREPARE_FLAG)) {
+		data->error = -ENOMEM;
+		return -ENOMEM;
+	}
+
+	/* start the command first*/
+	if (msdc_command_start(host, cmd, 1, CMD_TIMEOUT) != 0)
+		return -EIO;
+
+	msdc_dma_setup(host, &host->dma, data->sg,
+		       data->sg_count);
+
+	/* then wait command done */
+	if (msdc_command_resp(host, cmd, 1, CMD_TIMEOUT) != 0)
+		return -EIO;
+
+	return 0;
+}
+
+/* xfer_done never came, give up on the transfer */
+static void msdc_data_timeout(struct msdc_host *host, struct mmc_data *data)
+{
+	void __iomem *base = host->base;
+
+	ERR_MSG("XXX CMD<%d> wait xfer_done<%d> timeout!!", host->mrq->cmd->opcode, data->blocks * data->blksz);
+	ERR_MSG("    DMA_SA   = 0x%x", sdr_read32(MSDC_DMA_SA));
+	ERR_MSG("    DMA_CA   = 0x%x", sdr_read32(MSDC_DMA_CA));
+	ERR_MSG("    DMA_CTRL = 0x%x", sdr_read32(MSDC_DMA_CTRL));
+	ERR_MSG("    DMA_CFG  = 0x%x", sdr_read32(MSDC_DMA_CFG));
+	data->error = -ETIMEDOUT;
+
+	msdc_reset_hw(host);
+	msdc_clr_fifo();
+	msdc_clr_int();
+}
+
+/* called once xfer_done completed or timed out */
+static void msdc_finish_data(struct msdc_host *host, struct mmc_data *data)
+	__must_hold(&host->lock)
+{
+	msdc_dma_stop(host);
+
+	/* Last: stop transfer */
+	if (data->stop)
+		msdc_do_command(host, data->stop, 0, CMD_TIMEOUT);
+}
+
+/* releases the data of mrq, returns the error flags of the request */
+static int msdc_request_result(struct msdc_host *host, struct mmc_request *mrq)
+{
+	struct mmc_data *data = mrq->cmd->data;
+
+	if (data != NULL) {
+		host->data = NULL;
+		msdc_unprepare_data(host, data);
+		host->blksz = 0;
+	}
+
+	host->error = 0;
+	if (mrq->cmd->error)
+		host->error = 0x001;
+	if (mrq->data && mrq->data->error)
+		host->error |= 0x010;
+	if (mrq->stop && mrq->stop->error)
+		host->error |= 0x100;
+
+	//if (host->error) ERR_MSG("host->error<%d>", host->error);
+
+	return host->error;
+}
+
 static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	__must_hold(&host->lock)
 {
 	struct msdc_host *host = mmc_priv(mmc);
 	struct mmc_command *cmd;
 	struct mmc_data *data;
-	void __iomem *base = host->base;
 	//u32 intsts = 0;
 	int read = 1, send_type = 0;
 
@@ -1153,8 +1289,6 @@ static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	BUG_ON(mmc == NULL);
 	BUG_ON(mrq == NULL);
 
-	host->error = 0;
-
 	cmd  = mrq->cmd;
 	data = mrq->cmd->data;
 
@@ -1170,40 +1304,10 @@ static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
 		if (msdc_do_command(host, cmd, 1, CMD_TIMEOUT) != 0)
 			goto done;
 	} else {
-		BUG_ON(data->blksz > HOST_MAX_BLKSZ);
 		send_type = SND_DAT;
-
-		data->error = 0;
 		read = data->flags & MMC_DATA_READ ? 1 : 0;
-		host->data = data;
-		host->xfer_size = data->blocks * data->blksz;
-		host->blksz = data->blksz;
-
-		if (read) {
-			if ((host->timeout_ns != data->timeout_ns) ||
-				(host->timeout_clks != data->timeout_clks)) {
-				msdc_set_timeout(host, data->timeout_ns, data->timeout_clks);
-			}
-		}
 
-		sdr_write32(SDC_BLK_NUM, data->blocks);
-		//msdc_clr_fifo();  /* no need */
-
-		msdc_dma_on();  /* enable DMA mode first!! */
-		init_completion(&host->xfer_done);
-
-		/* start the command first*/
-		if (msdc_command_start(host, cmd, 1, CMD_TIMEOUT) != 0)
-			goto done;
-
-		data->sg_count = dma_map_sg(mmc_dev(mmc), data->sg,
-					    data->sg_len,
-					    mmc_get_dma_dir(data));
-		msdc_dma_setup(host, &host->dma, data->sg,
-			       data->sg_count);
-
-		/* then wait command done */
-		if (msdc_command_resp(host, cmd, 1, CMD_TIMEOUT) != 0)
+		if (msdc_start_data(host, mrq) != 0)
 			goto done;
 
 		/* for read, the data coming too fast, then CRC error
@@ -1212,35 +1316,15 @@ static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
 		msdc_dma_start(host);
 
 		spin_unlock(&host->lock);
-		if (!wait_for_completion_timeout(&host->xfer_done, DAT_TIMEOUT)) {
-			ERR_MSG("XXX CMD<%d> wait xfer_done<%d> timeout!!", cmd->opcode, data->blocks * data->blksz);
-			ERR_MSG("    DMA_SA   = 0x%x", sdr_read32(MSDC_DMA_SA));
-			ERR_MSG("    DMA_CA   = 0x%x", sdr_read32(MSDC_DMA_CA));
-			ERR_MSG("    DMA_CTRL = 0x%x", sdr_read32(MSDC_DMA_CTRL));
-			ERR_MSG("    DMA_CFG  = 0x%x", sdr_read32(MSDC_DMA_CFG));
-			data->error = -ETIMEDOUT;
-
-			msdc_reset_hw(host);
-			msdc_clr_fifo();
-			msdc_clr_int();
-		}
+		if (!wait_for_completion_timeout(&host->xfer_done, DAT_TIMEOUT))
+			msdc_data_timeout(host, data);
 		spin_lock(&host->lock);
-		msdc_dma_stop(host);
 
-		/* Last: stop transfer */
-		if (data->stop) {
-			if (msdc_do_command(host, data->stop, 0, CMD_TIMEOUT) != 0)
-				goto done;
-		}
+		msdc_finish_data(host, data);
 	}
 
 done:
 	if (data != NULL) {
-		host->data = NULL;
-		dma_unmap_sg(mmc_dev(mmc), data->sg, data->sg_len,
-			     mmc_get_dma_dir(data));
-		host->blksz = 0;
-
 #if 0 // don't stop twice!
 		if (host->hw->flags & MSDC_REMOVABLE && data->error) {
 			msdc_abort_data(host);
@@ -1277,16 +1361,7 @@ done:
 #endif
 #endif /* end of --- */
 
-	if (mrq->cmd->error)
-		host->error = 0x001;
-	if (mrq->data && mrq->data->error)
-		host->error |= 0x010;
-	if (mrq->stop && mrq->stop->error)
-		host->error |= 0x100;
-
-	//if (host->error) ERR_MSG("host->error<%d>", host->error);
-
-	return host->error;
+	return msdc_request_result(host, mrq);
 }
 
 static int msdc_app_cmd(struct mmc_host *mmc, struct msdc_host *host)
@@ -1651,6 +1726,89 @@ static int msdc_tune_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	return ret;
 }
 
+/* failed data requests are retried with the tuned sample settings */
+static void msdc_retune_request(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct msdc_host *host = mmc_priv(mmc);
+
+	if (host->hw->flags & MSDC_REMOVABLE && ralink_soc == MT762X_SOC_MT7621AT && mrq->data && mrq->data->error)
+		msdc_tune_request(mmc, mrq);
+}
+
+/* called with host->lock held once mrq is finished, drops the lock */
+static void msdc_request_end(struct msdc_host *host, struct mmc_request *mrq)
+	__releases(&host->lock)
+{
+	/* ==== when request done, check if app_cmd ==== */
+	if (mrq->cmd->opcode == MMC_APP_CMD) {
+		host->app_cmd = 1;
+		host->app_cmd_arg = mrq->cmd->arg;  /* save the RCA */
+	} else {
+		host->app_cmd = 0;
+		//host->app_cmd_arg = 0;
+	}
+
+	host->mrq = NULL;
+	spin_unlock(&host->lock);
+
+	mmc_request_done(host->mmc, mrq);
+}
+
+/*
+ * Finishes a data request started by msdc_ops_request(), from the IRQ
+ * thread once xfer_done completed or from req_timeout_work after
+ * DAT_TIMEOUT.
+ */
+static void msdc_request_complete(struct msdc_host *host, bool timeout)
+{
+	struct mmc_request *mrq;
+	bool done;
+
+	spin_lock(&host->lock);
+	if (!host->req_async) {
+		spin_unlock(&host->lock);
+		return;
+	}
+
+	done = try_wait_for_completion(&host->xfer_done);
+	/* a late interrupt of the previous request woke the thread */
+	if (!done && !timeout) {
+		spin_unlock(&host->lock);
+		return;
+	}
+	/* the timeout of the previous request ran late */
+	if (!done && time_before(jiffies, host->req_timeout)) {
+		schedule_delayed_work(&host->req_timeout_work,
+				      host->req_timeout - jiffies);
+		spin_unlock(&host->lock);
+		return;
+	}
+	host->req_async = false;
+	mrq = host->mrq;
+	spin_unlock(&host->lock);
+
+	cancel_delayed_work(&host->req_timeout_work);
+
+	/* the reset may wait for the FIFO, keep it out of the lock */
+	if (!done)
+		msdc_data_timeout(host, mrq->data);
+
+	spin_lock(&host->lock);
+	msdc_finish_data(host, mrq->data);
+	if (msdc_request_result(host, mrq))
+		msdc_retune_request(host->mmc, mrq);
+
+	msdc_request_end(host, mrq);
+}
+
+static void msdc_request_timeout_work(struct work_struct *work)
+{
+	struct msdc_host *host = container_of(work, struct msdc_host,
+					      req_timeout_work.work);
+
+	msdc_request_complete(host, true);
+}
+
 /* ops.request */
 static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
 {
@@ -1675,22 +1833,23 @@ static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
 
 	host->mrq = mrq;
 
-	if (msdc_do_request(mmc, mrq)) {
-		if (host->hw->flags & MSDC_REMOVABLE && ralink_soc == MT762X_SOC_MT7621AT && mrq->data && mrq->data->error)
-			msdc_tune_request(mmc, mrq);
-	}
-
-	/* ==== when request done, check if app_cmd ==== */
-	if (mrq->cmd->opcode == MMC_APP_CMD) {
-		host->app_cmd = 1;
-		host->app_cmd_arg = mrq->cmd->arg;  /* save the RCA */
-	} else {
-		host->app_cmd = 0;
-		//host->app_cmd_arg = 0;
+	if (!mrq->data) {
+		msdc_do_request(mmc, mrq);
+	} else if (msdc_start_data(host, mrq) == 0) {
+		/*
+		 * Return while the DMA runs so the core can prepare the next
+		 * request, msdc_irq_thread() completes this one.
+		 */
+		host->req_async = true;
+		host->req_timeout = jiffies + DAT_TIMEOUT;
+		schedule_delayed_work(&host->req_timeout_work, DAT_TIMEOUT);
+		msdc_dma_start(host);
+		spin_unlock(&host->lock);
+		return;
+	} else if (msdc_request_result(host, mrq)) {
+		msdc_retune_request(mmc, mrq);
 	}
 
-	host->mrq = NULL;
-
 #if 0 /* --- by chhung */
 	//=== for sdio profile ===
 	if (sdio_pro_enable) {
@@ -1711,11 +1870,7 @@ static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
 		}
 	}
 #endif /* end of --- */
-	spin_unlock(&host->lock);
-
-	mmc_request_done(mmc, mrq);
-
-	return;
+	msdc_request_end(host, mrq);
 }
 
 /* called by ops.set_ios */
@@ -1873,7 +2028,37 @@ static int msdc_ops_get_cd(struct mmc_host *mmc)
 	return present;
 }
 
+/* ops.pre_req, map the next request while the current one transfers */
+static void msdc_ops_pre_req(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct msdc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data)
+		return;
+
+	msdc_prepare_data(host, data);
+	if (data->host_cookie & MSDC_PREPARE_FLAG)
+		data->host_cookie |= MSDC_ASYNC_FLAG;
+}
+
+/* ops.post_req */
+static void msdc_ops_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			      int err)
+{
+	struct msdc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data || !data->host_cookie)
+		return;
+
+	data->host_cookie &= ~MSDC_ASYNC_FLAG;
+	msdc_unprepare_data(host, data);
+}
+
 static struct mmc_host_ops mt_msdc_ops = {
+	.pre_req         = msdc_ops_pre_req,
+	.post_req        = msdc_ops_post_req,
 	.request         = msdc_ops_request,
 	.set_ios         = msdc_ops_set_ios,
 	.get_ro          = msdc_ops_get_ro,
@@ -1889,6 +2074,7 @@ static irqreturn_t msdc_irq(int irq, void *dev_id)
 	struct mmc_data   *data = host->data;
 	struct mmc_command *cmd = host->cmd;
 	void __iomem *base = host->base;
+	irqreturn_t ret = IRQ_HANDLED;
 
 	u32 cmdsts = MSDC_INT_RSPCRCERR  | MSDC_INT_CMDTMO  | MSDC_INT_CMDRDY  |
 		MSDC_INT_ACMDCRCERR | MSDC_INT_ACMDTMO | MSDC_INT_ACMDRDY |
@@ -1940,6 +2126,9 @@ static irqreturn_t msdc_irq(int irq, void *dev_id)
 			//if(sdr_read32(MSDC_INTEN) & MSDC_INT_XFER_COMPL) {
 			complete(&host->xfer_done); /* Read CRC come fast, XFER_COMPL not enabled */
 		}
+
+		if (host->req_async && completion_done(&host->xfer_done))
+			ret = IRQ_WAKE_THREAD;
 	}
 
 	/* command interrupts */
@@ -2013,6 +2202,15 @@ static irqreturn_t msdc_irq(int irq, void *dev_id)
 	}
 #endif
 
+	return ret;
+}
+
+static irqreturn_t msdc_irq_thread(int irq, void *dev_id)
+{
+	struct msdc_host *host = dev_id;
+
+	msdc_request_complete(host, false);
+
 	return IRQ_HANDLED;
 }
 
@@ -2305,6 +2503,7 @@ static int msdc_drv_probe(struct platform_device *pdev)
 	msdc_init_gpd_bd(host, &host->dma);
 
 	INIT_DELAYED_WORK(&host->card_delaywork, msdc_tasklet_card);
+	INIT_DELAYED_WORK(&host->req_timeout_work, msdc_request_timeout_work);
 	spin_lock_init(&host->lock);
 	msdc_init_hw(host);
 
@@ -2315,8 +2514,8 @@ static int msdc_drv_probe(struct platform_device *pdev)
 	 * device tree, but not the oneshot flag, but maybe it is also
 	 * not needed because the soc could be oneshot safe.
 	 */
-	ret = devm_request_irq(&pdev->dev, host->irq, msdc_irq, 0, pdev->name,
-			       host);
+	ret = devm_request_threaded_irq(&pdev->dev, host->irq, msdc_irq,
+					msdc_irq_thread, 0, pdev->name, host);
 	if (ret)
 		goto release;
 
@@ -2372,6 +2571,7 @@ static int msdc_drv_remove(struct platform_device *pdev)
 	msdc_deinit_hw(host);
 
 	cancel_delayed_work_sync(&host->card_delaywork);
+	cancel_delayed_work_sync(&host->req_timeout_work);
 
 	dma_free_coherent(&pdev->dev, MAX_GPD_NUM * sizeof(struct gpd),
 			  host->dma.gpd, host->dma.gpd_addr);
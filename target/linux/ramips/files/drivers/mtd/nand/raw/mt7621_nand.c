@@ -13,6 +13,7 @@
 #include <linux/errno.h>
 #include <linux/sizes.h>
 #include <linux/iopoll.h>
+#include <linux/dma-mapping.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/mtd/mtd.h>
@@ -30,7 +31,9 @@
 #define   CNFG_AUTO_FMT_EN		BIT(9)
 #define   CNFG_HW_ECC_EN		BIT(8)
 #define   CNFG_BYTE_RW			BIT(6)
+#define   CNFG_DMA_BURST_EN		BIT(2)
 #define   CNFG_READ_MODE		BIT(1)
+#define   CNFG_AHB			BIT(0)
 
 #define NFI_PAGEFMT			0x004
 #define   PAGEFMT_FDM_ECC_S		12
@@ -114,6 +117,10 @@
 #define   SEC_ADDR_S			0
 #define   SEC_ADDR_M			GENMASK(9, 0)
 
+#define NFI_STRADDR			0x080
+
+#define NFI_BYTELEN			0x084
+
 #define NFI_CSEL			0x090
 #define   CSEL_S			0
 #define   CSEL_M			GENMASK(1, 0)
@@ -156,6 +163,7 @@
 #define   DEC_CON_S			12
 #define   DEC_CON_M			GENMASK(13, 12)
 #define     DEC_CON_EL			2
+#define     DEC_CON_CORRECT		3
 #define   DEC_MODE_S			4
 #define   DEC_MODE_M			GENMASK(5, 4)
 #define     DEC_MODE_NFI		1
@@ -226,6 +234,10 @@ static const u16 mt7621_nfi_page_size[] = { SZ_512, SZ_2K, SZ_4K };
 static const u8 mt7621_nfi_spare_size[] = { 16, 26, 27, 28 };
 static const u8 mt7621_ecc_strength[] = { 4, 6, 8, 10, 12 };
 
+static bool use_dma;
+module_param(use_dma, bool, 0444);
+MODULE_PARM_DESC(use_dma, "Move ECC page data through NFI DMA (experimental)");
+
 static inline u32 nfi_read32(struct mt7621_nfc *nfc, u32 reg)
 {
 	return readl(nfc->nfi_regs + reg);
@@ -328,6 +340,16 @@ static void mt7621_ecc_decoder_op(struct mt7621_nfc *nfc, bool enable)
 	ecc_write16(nfc, ECC_DECCON, enable ? DEC_EN : 0);
 }
 
+static void mt7621_ecc_decoder_set_con(struct mt7621_nfc *nfc, u32 con)
+{
+	u32 val;
+
+	mt7621_ecc_wait_idle(nfc, ECC_DECIDLE);
+
+	val = ecc_read32(nfc, ECC_DECCNFG) & ~DEC_CON_M;
+	ecc_write32(nfc, ECC_DECCNFG, val | (con << DEC_CON_S));
+}
+
 static int mt7621_ecc_correct_check(struct mt7621_nfc *nfc, u8 *sector_buf,
 				   u8 *fdm_buf, u32 sect)
 {
@@ -392,6 +414,25 @@ static int mt7621_nfc_wait_write_completion(struct mt7621_nfc *nfc,
 	return ret;
 }
 
+static int mt7621_nfc_wait_read_completion(struct mt7621_nfc *nfc,
+					   struct nand_chip *nand)
+{
+	struct device *dev = nfc->dev;
+	u32 val;
+	int ret;
+
+	ret = readl_poll_timeout_atomic(nfc->nfi_regs + NFI_BYTELEN, val,
+		((val & SEC_CNTR_M) >> SEC_CNTR_S) >= nand->ecc.steps, 10,
+		NFI_CORE_TIMEOUT);
+
+	if (ret) {
+		dev_warn(dev, "NFI core read operation timed out\n");
+		return -ETIMEDOUT;
+	}
+
+	return ret;
+}
+
 static void mt7621_nfc_hw_reset(struct mt7621_nfc *nfc)
 {
 	u32 val;
@@ -1001,8 +1042,9 @@ static void mt7621_nfc_read_sector_fdm(struct mt7621_nfc *nfc, u32 sect)
 		oobptr[i + 4] = (valm >> (i * 8)) & 0xff;
 }
 
-static int mt7621_nfc_read_page_hwecc(struct nand_chip *nand, uint8_t *buf,
-				      int oob_required, int page)
+static int mt7621_nfc_read_page_hwecc_pio(struct nand_chip *nand,
+					  uint8_t *buf, int oob_required,
+					  int page)
 {
 	struct mt7621_nfc *nfc = nand_get_controller_data(nand);
 	struct mtd_info *mtd = nand_to_mtd(nand);
@@ -1058,6 +1100,87 @@ static int mt7621_nfc_read_page_hwecc(struct nand_chip *nand, uint8_t *buf,
 	return bitflips;
 }
 
+static int mt7621_nfc_read_page_hwecc(struct nand_chip *nand, uint8_t *buf,
+				      int oob_required, int page)
+{
+	struct mt7621_nfc *nfc = nand_get_controller_data(nand);
+	struct mtd_info *mtd = nand_to_mtd(nand);
+	u8 *dmabuf = buf ? buf : nand_get_data_buf(nand);
+	dma_addr_t dma_addr;
+	int bitflips = 0;
+	u32 decnum;
+	int rc, i;
+
+	if (!use_dma)
+		return mt7621_nfc_read_page_hwecc_pio(nand, buf, oob_required,
+						      page);
+
+	dma_addr = dma_map_single(nfc->dev, dmabuf, mtd->writesize,
+				  DMA_FROM_DEVICE);
+	if (dma_mapping_error(nfc->dev, dma_addr))
+		return mt7621_nfc_read_page_hwecc_pio(nand, buf, oob_required,
+						      page);
+
+	nand_read_page_op(nand, page, 0, NULL, 0);
+
+	nfi_write16(nfc, NFI_CNFG, (CNFG_OP_CUSTOM << CNFG_OP_MODE_S) |
+		    CNFG_READ_MODE | CNFG_AUTO_FMT_EN | CNFG_HW_ECC_EN |
+		    CNFG_DMA_BURST_EN | CNFG_AHB);
+
+	/*
+	 * ECC_DECEL only holds the error locations of the last decoded
+	 * sector, which is gone by the time the whole page is in memory.
+	 * Let the decoder fix the sector data and the FDM itself instead.
+	 */
+	mt7621_ecc_decoder_set_con(nfc, DEC_CON_CORRECT);
+	mt7621_ecc_decoder_op(nfc, true);
+
+	nfi_write32(nfc, NFI_STRADDR, dma_addr);
+	nfi_write16(nfc, NFI_CON,
+		    CON_NFI_BRD | (nand->ecc.steps << CON_NFI_SEC_S));
+	nfi_write16(nfc, NFI_STRDATA, STR_DATA);
+
+	rc = mt7621_nfc_wait_read_completion(nfc, nand);
+
+	/* the decoder may still be fixing up the last sectors in memory */
+	for (i = 0; i < nand->ecc.steps && rc >= 0; i++)
+		rc = mt7621_ecc_decoder_wait_done(nfc, i);
+
+	dma_unmap_single(nfc->dev, dma_addr, mtd->writesize, DMA_FROM_DEVICE);
+
+	if (rc < 0) {
+		bitflips = -EIO;
+		goto out;
+	}
+
+	decnum = ecc_read32(nfc, ECC_DECENUM);
+
+	for (i = 0; i < nand->ecc.steps; i++) {
+		mt7621_nfc_read_sector_fdm(nfc, i);
+
+		rc = (decnum >> (i << ERRNUM_S)) & ERRNUM_M;
+
+		if (rc == ERRNUM_M) {
+			dev_dbg(nfc->dev,
+				 "Uncorrectable ECC error at page %d.%d\n",
+				 page, i);
+			bitflips = -EBADMSG;
+			mtd->ecc_stats.failed++;
+		} else if (bitflips >= 0) {
+			bitflips += rc;
+			mtd->ecc_stats.corrected += rc;
+		}
+	}
+
+out:
+	mt7621_ecc_decoder_op(nfc, false);
+	mt7621_ecc_decoder_set_con(nfc, DEC_CON_EL);
+
+	nfi_write16(nfc, NFI_CON, 0);
+
+	return bitflips;
+}
+
 static int mt7621_nfc_read_page_raw(struct nand_chip *nand, uint8_t *buf,
 				    int oob_required, int page)
 {
@@ -1125,12 +1248,47 @@ static int mt7621_nfc_check_empty_page(struct nand_chip *nand, const u8 *buf)
 	return 1;
 }
 
+static int mt7621_nfc_write_page_hwecc_pio(struct nand_chip *nand,
+					   const uint8_t *buf,
+					   int oob_required, int page)
+{
+	struct mt7621_nfc *nfc = nand_get_controller_data(nand);
+	struct mtd_info *mtd = nand_to_mtd(nand);
+
+	nand_prog_page_begin_op(nand, page, 0, NULL, 0);
+
+	nfi_write16(nfc, NFI_CNFG, (CNFG_OP_CUSTOM << CNFG_OP_MODE_S) |
+		   CNFG_AUTO_FMT_EN | CNFG_HW_ECC_EN);
+
+	mt7621_ecc_encoder_op(nfc, true);
+
+	mt7621_nfc_write_fdm(nfc);
+
+	nfi_write16(nfc, NFI_CON,
+		    CON_NFI_BWR | (nand->ecc.steps << CON_NFI_SEC_S));
+
+	if (buf)
+		mt7621_nfc_write_data(nfc, buf, mtd->writesize);
+	else
+		mt7621_nfc_write_data_empty(nfc, mtd->writesize);
+
+	mt7621_nfc_wait_write_completion(nfc, nand);
+
+	mt7621_ecc_encoder_op(nfc, false);
+
+	nfi_write16(nfc, NFI_CON, 0);
+
+	return nand_prog_page_end_op(nand);
+}
+
 static int mt7621_nfc_write_page_hwecc(struct nand_chip *nand,
 				       const uint8_t *buf, int oob_required,
 				       int page)
 {
 	struct mt7621_nfc *nfc = nand_get_controller_data(nand);
 	struct mtd_info *mtd = nand_to_mtd(nand);
+	dma_addr_t dma_addr;
+	u8 *dmabuf;
 
 	if (mt7621_nfc_check_empty_page(nand, buf)) {
 		/*
@@ -1145,25 +1303,42 @@ static int mt7621_nfc_write_page_hwecc(struct nand_chip *nand,
 		return 0;
 	}
 
+	if (!use_dma)
+		return mt7621_nfc_write_page_hwecc_pio(nand, buf, oob_required,
+						       page);
+
+	if (buf) {
+		dmabuf = (u8 *)buf;
+	} else {
+		dmabuf = nand_get_data_buf(nand);
+		memset(dmabuf, 0xff, mtd->writesize);
+	}
+
+	dma_addr = dma_map_single(nfc->dev, dmabuf, mtd->writesize,
+				  DMA_TO_DEVICE);
+	if (dma_mapping_error(nfc->dev, dma_addr))
+		return mt7621_nfc_write_page_hwecc_pio(nand, buf, oob_required,
+						       page);
+
 	nand_prog_page_begin_op(nand, page, 0, NULL, 0);
 
 	nfi_write16(nfc, NFI_CNFG, (CNFG_OP_CUSTOM << CNFG_OP_MODE_S) |
-		   CNFG_AUTO_FMT_EN | CNFG_HW_ECC_EN);
+		   CNFG_AUTO_FMT_EN | CNFG_HW_ECC_EN | CNFG_DMA_BURST_EN |
+		   CNFG_AHB);
 
 	mt7621_ecc_encoder_op(nfc, true);
 
 	mt7621_nfc_write_fdm(nfc);
 
+	nfi_write32(nfc, NFI_STRADDR, dma_addr);
 	nfi_write16(nfc, NFI_CON,
 		    CON_NFI_BWR | (nand->ecc.steps << CON_NFI_SEC_S));
-
-	if (buf)
-		mt7621_nfc_write_data(nfc, buf, mtd->writesize);
-	else
-		mt7621_nfc_write_data_empty(nfc, mtd->writesize);
+	nfi_write16(nfc, NFI_STRDATA, STR_DATA);
 
 	mt7621_nfc_wait_write_completion(nfc, nand);
 
+	dma_unmap_single(nfc->dev, dma_addr, mtd->writesize, DMA_TO_DEVICE);
+
 	mt7621_ecc_encoder_op(nfc, false);
 
 	nfi_write16(nfc, NFI_CON, 0);
@@ -1230,6 +1405,8 @@ static int mt7621_nfc_init_chip(struct mt7621_nfc *nfc)
 	nand_set_flash_node(nand, nfc->dev->of_node);
 
 	nand->options |= NAND_USES_DMA | NAND_NO_SUBPAGE_WRITE | NAND_SKIP_BBTSCAN;
+	/* page buffers are DMA'd from/to, keep them off shared cache lines */
+	nand->buf_align = dma_get_cache_alignment();
 	if (!nfc->nfi_clk)
 		nand->options |= NAND_KEEP_TIMINGS;
 